@@ -0,0 +1,245 @@
+#include "json.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_COLLIDING_KEYS 3125
+#define SMALL_OBJECT_COUNT 10000
+#define STRING_COUNT 5000
+#define REPETITIONS 20
+
+// Returns the i-th of 3125 different keys that all have the same elf_hash()
+// The digits d of i in base 5 are added to the characters, and 16 * d is subtracted from the next one,
+// which cancels out, since elf_hash() shifts its hash left by 4 bits before adding the next character
+static void get_colliding_key(size_t i, char *key) {
+	int previous_digit = 0;
+
+	for (size_t j = 0; j < 5; j++) {
+		int digit = i % 5;
+		i /= 5;
+
+		key[j] = 'd' + digit - 16 * previous_digit;
+		previous_digit = digit;
+	}
+
+	key[5] = 'd' - 16 * previous_digit;
+	key[6] = '\0';
+}
+
+static void get_ordinary_key(size_t i, char *key) {
+	sprintf(key, "k%05zu", i);
+}
+
+// Writes an object like {"key0":"","key1":""}
+static size_t generate_object(char *text, size_t key_count, void (*get_key)(size_t i, char *key)) {
+	size_t size = 0;
+
+	text[size++] = '{';
+
+	for (size_t i = 0; i < key_count; i++) {
+		char key[32];
+		get_key(i, key);
+
+		size += sprintf(text + size, "%s\"%s\":\"\"", i > 0 ? "," : "", key);
+	}
+
+	text[size++] = '}';
+
+	return size;
+}
+
+// Writes an array like [{"id":"","name":"","tags":""},{"id":"","name":"","tags":""}]
+static size_t generate_small_objects(char *text) {
+	size_t size = 0;
+
+	text[size++] = '[';
+
+	for (size_t i = 0; i < SMALL_OBJECT_COUNT; i++) {
+		size += sprintf(text + size, "%s{\"id\":\"\",\"name\":\"\",\"tags\":\"\"}", i > 0 ? "," : "");
+	}
+
+	text[size++] = ']';
+
+	return size;
+}
+
+// Writes an array of strings that are mostly ASCII, like ["Grüße, 0","Grüße, 1"]
+static size_t generate_strings(char *text) {
+	size_t size = 0;
+
+	text[size++] = '[';
+
+	for (size_t i = 0; i < STRING_COUNT; i++) {
+		size += sprintf(text + size, "%s\"Gr\xc3\xbc\xc3\x9f" "e from the mod loader, %zu\"", i > 0 ? "," : "", i);
+	}
+
+	text[size++] = ']';
+
+	return size;
+}
+
+static double get_seconds(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Returns the fastest time it took to parse the text, in nanoseconds per item
+static double time_parse(char *text, size_t size, size_t item_count, void *buffer, size_t buffer_capacity) {
+	double best = 0;
+
+	for (size_t i = 0; i < REPETITIONS; i++) {
+		struct json_node node;
+
+		double start = get_seconds();
+		enum json_status status = json_parse_memory(text, size, &node, buffer, buffer_capacity);
+		double seconds = get_seconds() - start;
+
+		assert(status == JSON_OK);
+
+		if (i == 0 || seconds < best) {
+			best = seconds;
+		}
+	}
+
+	return best * 1e9 / item_count;
+}
+
+// Returns the fastest time it took to index the array of small objects and read one of its strings, in nanoseconds per object
+static double time_index(char *text, size_t size, void *buffer, size_t buffer_capacity) {
+	double best = 0;
+
+	for (size_t i = 0; i < REPETITIONS; i++) {
+		struct json_cursor root;
+		struct json_cursor object;
+		struct json_cursor name;
+		char *string;
+
+		double start = get_seconds();
+		enum json_status status = json_index_memory(text, size, &root, buffer, buffer_capacity);
+		assert(status == JSON_OK);
+		assert(json_cursor_first(&root, &object));
+		assert(json_cursor_field(&object, "name", &name) == JSON_OK);
+		assert(json_cursor_get_string(&name, &string) == JSON_OK);
+		double seconds = get_seconds() - start;
+
+		if (i == 0 || seconds < best) {
+			best = seconds;
+		}
+	}
+
+	return best * 1e9 / SMALL_OBJECT_COUNT;
+}
+
+// Returns the fastest time it took to write the parsed text back out, in nanoseconds per item
+static double time_write(char *text, size_t size, size_t item_count, void *buffer, size_t buffer_capacity) {
+	struct json_node node;
+	enum json_status status = json_parse_memory(text, size, &node, buffer, buffer_capacity);
+	assert(status == JSON_OK);
+
+	static char written[SMALL_OBJECT_COUNT * 32];
+	struct json_write_level levels[2];
+
+	double best = 0;
+
+	for (size_t i = 0; i < REPETITIONS; i++) {
+		double start = get_seconds();
+		size_t length;
+		status = json_write(&node, false, levels, sizeof(levels) / sizeof(*levels), written, sizeof(written), &length);
+		double seconds = get_seconds() - start;
+
+		assert(status == JSON_OK);
+		assert(length == size);
+
+		if (i == 0 || seconds < best) {
+			best = seconds;
+		}
+	}
+
+	return best * 1e9 / item_count;
+}
+
+// Returns how long json_object_get() takes to find a key, in nanoseconds
+static double time_lookups(char *text, size_t key_count, void *buffer, size_t buffer_capacity) {
+	size_t size = generate_object(text, key_count, get_ordinary_key);
+
+	struct json_node node;
+	enum json_status status = json_parse_memory(text, size, &node, buffer, buffer_capacity);
+	assert(status == JSON_OK);
+
+	double start = get_seconds();
+
+	for (size_t i = 0; i < REPETITIONS; i++) {
+		for (size_t j = 0; j < key_count; j++) {
+			struct json_node *value = json_object_get(&node.object, node.object.fields[j].key);
+			assert(value == node.object.fields[j].value);
+		}
+	}
+
+	return (get_seconds() - start) * 1e9 / (REPETITIONS * key_count);
+}
+
+// Parses objects whose keys all collide in the old hash table, and objects with ordinary keys
+// If the duplicate key check is linear, the time per key stays about the same as the objects grow
+// Most objects are tiny though, so an array of small objects is timed as well
+// Reading one string from an index of them should be faster than building the whole tree
+// Projecting one key still lexes and checks every key and value, so with values this small it takes about as long,
+// and only saves the buffer the room for the values that are left out
+// The objects are also written back out
+// Then strings are parsed with and without validating their UTF-8
+// Lastly, the keys of the objects are looked up
+int main(void) {
+	static char text[SMALL_OBJECT_COUNT * 32];
+	static char buffer[8400000];
+
+	assert(!json_init(buffer, sizeof(buffer)));
+
+	printf("%8s %22s %22s\n", "keys", "colliding ns/key", "ordinary ns/key");
+
+	size_t key_counts[] = {100, 300, 1000, MAX_COLLIDING_KEYS};
+
+	for (size_t i = 0; i < sizeof(key_counts) / sizeof(*key_counts); i++) {
+		size_t key_count = key_counts[i];
+
+		size_t size = generate_object(text, key_count, get_colliding_key);
+		double colliding = time_parse(text, size, key_count, buffer, sizeof(buffer));
+
+		size = generate_object(text, key_count, get_ordinary_key);
+		double ordinary = time_parse(text, size, key_count, buffer, sizeof(buffer));
+
+		printf("%8zu %22.1f %22.1f\n", key_count, colliding, ordinary);
+	}
+
+	size_t size = generate_small_objects(text);
+	double small = time_parse(text, size, SMALL_OBJECT_COUNT, buffer, sizeof(buffer));
+
+	double indexed = time_index(text, size, buffer, sizeof(buffer));
+
+	const char *paths[] = {"$[*].name"};
+	assert(json_set_projection(buffer, paths, 1) == JSON_OK);
+	double projected = time_parse(text, size, SMALL_OBJECT_COUNT, buffer, sizeof(buffer));
+	assert(json_set_projection(buffer, NULL, 0) == JSON_OK);
+
+	printf("\n%zu objects with 3 keys: %.1f ns/object, %.1f ns/object when only one string is read from an index\n", (size_t)SMALL_OBJECT_COUNT, small, indexed);
+	printf("%.1f ns/object when only one of the keys is projected\n", projected);
+	printf("%.1f ns/object to write them back out\n", time_write(text, size, SMALL_OBJECT_COUNT, buffer, sizeof(buffer)));
+
+	// Validating the UTF-8 of the strings should barely make a difference
+	size = generate_strings(text);
+	double unvalidated = time_parse(text, size, STRING_COUNT, buffer, sizeof(buffer));
+	json_set_validates_utf8(buffer, true);
+	double validated = time_parse(text, size, STRING_COUNT, buffer, sizeof(buffer));
+	json_set_validates_utf8(buffer, false);
+
+	printf("\n%zu strings: %.1f ns/string, %.1f ns/string with UTF-8 validation\n", (size_t)STRING_COUNT, unvalidated, validated);
+
+	// With an index the time per lookup shouldn't grow with the number of keys
+	printf("\n%8s %22s\n", "keys", "json_object_get() ns");
+
+	for (size_t i = 0; i < sizeof(key_counts) / sizeof(*key_counts); i++) {
+		printf("%8zu %22.1f\n", key_counts[i], time_lookups(text, key_counts[i], buffer, sizeof(buffer)));
+	}
+}
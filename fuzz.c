@@ -90,9 +90,8 @@ int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
 		initialized = true;
 	}
 
-	char* file = buf_to_file(data, size);
-	if (file == NULL) {
-		exit(EXIT_FAILURE);
+	if (size == 0) {
+		return EXIT_SUCCESS;
 	}
 
 	static char buffer[420420];
@@ -101,6 +100,22 @@ int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
 
 	struct json_node node;
 
+	// The first byte picks whether the rest is parsed from memory or from a file,
+	// so both json_parse_memory() and the file reading of json() get fuzzed
+	bool parses_file = data[0] & 1;
+	data++;
+	size--;
+
+	if (!parses_file) {
+		(void)json_parse_memory((const char *)data, size, &node, buffer, sizeof(buffer));
+		return EXIT_SUCCESS;
+	}
+
+	char* file = buf_to_file(data, size);
+	if (file == NULL) {
+		exit(EXIT_FAILURE);
+	}
+
 	(void)json(file, &node, buffer, sizeof(buffer));
 
 	if (delete_file(file) != 0) {
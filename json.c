@@ -1,19 +1,71 @@
 #include "json.h"
 
 #include <ctype.h>
+#include <float.h>
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+#include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
 #include <setjmp.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
 
-#define MAX_CHILD_NODES 420
-#define MAX_RECURSION_DEPTH 42
+#define MAX_BATCH_THREADS 64
+#define MAX_DIRECTLY_COMPARED_FIELDS 8
+
+// The counting pass keeps track of the arrays and objects this many levels deep,
+// and assumes that the values deeper than that are kept, and that their objects need an index
+#define MAX_COUNTED_OBJECT_DEPTH 64
+
+// json_sax() feeds a file in chunks of this size, so no more of it is in memory at once
+#define SAX_CHUNK_SIZE 16384
+
+// Every projection path gets a bit in a uint64_t
+#define MAX_PROJECTION_PATHS 64
+
+// The step that a projection path is at is stored as an offset into it
+#define MAX_PROJECTION_PATH_LENGTH UINT16_MAX
+
+// json_pointer_get_batch() remembers the nodes this many tokens deep that the previous pointer went through
+#define MAX_SHARED_POINTER_TOKENS 42
+
+// SIZE_MAX has 20 digits, so an index with fewer digits can't overflow
+#define MAX_POINTER_INDEX_DIGITS 19
+
+// Enough for any double that json_write() prints with 17 significant digits
+#define MAX_WRITTEN_NUMBER_LENGTH 32
+
+// "JSONSNAP" on little-endian CPUs, so snapshots from CPUs with another byte order are rejected
+#define SNAPSHOT_MAGIC 0x50414e534e4f534aULL
+
+// Increased whenever the layout of the tape words changes
+#define SNAPSHOT_VERSION 1
+
+// A double never needs more significant digits than this to be rounded correctly,
+// so any digits after these only matter for whether they're all zero
+#define MAX_SIGNIFICANT_DIGITS 768
+
+// Enough for an 'e', a '-', and any int64_t
+#define MAX_EXPONENT_LENGTH 21
+
+// A tape word has its tag in the top byte, and its payload in the other 7 bytes
+#define TAPE_TAG_SHIFT 56
+#define TAPE_PAYLOAD_MASK ((1ULL << TAPE_TAG_SHIFT) - 1)
 
 #define json_error(error) {\
-	error_line_number = __LINE__;\
-	longjmp(error_jmp_buffer, error);\
+	g->error_line_number = __LINE__;\
+	longjmp(g->error_jmp_buffer, error);\
 }
 
 #define json_assert(condition, error) {\
@@ -22,10 +74,6 @@
 	}\
 }
 
-static jmp_buf error_jmp_buffer;
-
-static int error_line_number;
-
 enum token_type {
 	TOKEN_TYPE_STRING,
 	TOKEN_TYPE_ARRAY_OPEN,
@@ -34,23 +82,145 @@ enum token_type {
 	TOKEN_TYPE_OBJECT_CLOSE,
 	TOKEN_TYPE_COMMA,
 	TOKEN_TYPE_COLON,
+	TOKEN_TYPE_NUMBER,
+	TOKEN_TYPE_TRUE,
+	TOKEN_TYPE_FALSE,
+	TOKEN_TYPE_NULL,
 };
 
 struct token {
 	enum token_type type;
-	char *str;
+	union {
+		char *str;
+		double number;
+	};
+};
+
+// The generation says which object last used the bucket
+struct bucket {
+	uint32_t generation;
+	uint32_t field_index;
+};
+
+// Lets json_object_get() find a key in an object with lots of fields without comparing it to all of them
+// This is the hash table that the duplicate key check built for the object
+// It's right in front of the object's fields, so the nodes don't need to point to it
+struct json_object_index {
+	// The object's own fields and field count, which tell an object that has an index
+	// apart from one that was put together some other way
+	struct json_field *fields;
+	size_t field_count;
+
+	uint64_t hash_seed[2];
+	size_t bucket_mask;
+
+	// The buckets, followed by the chains
+	uint32_t slots[];
+};
+
+// Which of the projection paths a value can still lead to
+struct projection {
+	uint64_t paths;
+
+	// A path ended at the value, or there is no projection, so all of it is kept
+	bool is_kept;
+};
+
+// An open array or object
+struct frame {
+	bool is_object;
+	bool seen_key;
+	bool seen_colon;
+	bool seen_value;
+	bool seen_comma;
+	size_t child_count;
+
+	// Where the children start on the children stack,
+	// or where the keys start on the byte stack of a json_feed()
+	size_t children_start;
+
+	// The key of the field whose value is being parsed
+	char *key;
+
+	// Where the array's or object's opening word is on the tape
+	size_t tape_index;
+
+	// The projection of the array or object itself, and of the value of its current key
+	struct projection projection;
+	struct projection value_projection;
 };
 
-struct {
+// What the counting pass keeps track of for an open array or object
+struct counted_container {
+	bool is_object;
+	bool seen_key;
+
+	// Only the fields that the projection keeps end up in the tree
+	size_t kept_field_count;
+
+	struct projection projection;
+	struct projection value_projection;
+};
+
+// The start of a snapshot file, which is followed by the words of the tape, and then its strings
+struct snapshot_header {
+	uint64_t magic;
+	uint64_t version;
+	uint64_t word_count;
+	uint64_t strings_size;
+};
+
+// Everything a parse needs lives in this struct at the start of the caller's buffer,
+// so threads can parse at the same time as long as they use different buffers
+struct context {
 	bool initialized;
 
-	char *text;
+	// The number of bytes before this struct in the buffer, needed to align it to 16 bytes
+	size_t padding;
+
+	jmp_buf error_jmp_buffer;
+	int error_line_number;
+
+	size_t required_size;
+
+	size_t (*find_escaped_character)(const char *text, size_t i, size_t size);
+	size_t (*skip_whitespace)(const char *text, size_t i, size_t size);
+	bool (*is_valid_utf8)(const char *text, size_t size);
+
+	// Set with json_set_validates_utf8()
+	bool validates_utf8;
+
+	// Set with json_set_projection()
+	const char **projection_paths;
+	size_t projection_path_count;
+
+	// The offset of the step that every path is at for the keys at projection_steps_depth,
+	// so a key costs one comparison per path instead of a walk from the path's '$'
+	uint16_t projection_steps[MAX_PROJECTION_PATHS];
+	size_t projection_steps_depth;
+
+	// Values that the projection left out are still checked, but aren't stored or reported
+	struct projection root_projection;
+	struct projection value_projection;
+	bool skips_value;
+
+	const char *text;
 	size_t text_capacity;
 	size_t text_size;
 
+	// Text that is parsed straight from the caller's memory can't be modified,
+	// so its strings have to be copied instead of being terminated in place
+	bool copies_strings;
+
+	size_t text_index;
+
+	struct token token;
+	bool has_token;
+
 	struct token *tokens;
 	size_t tokens_capacity;
 	size_t tokens_size;
+	size_t token_index;
 
 	struct json_node *nodes;
 	size_t nodes_capacity;
@@ -61,66 +231,252 @@ struct {
 	size_t strings_size;
 
 	struct json_field *fields;
-	uint32_t *fields_buckets;
+	struct bucket *fields_buckets;
+	size_t fields_buckets_capacity;
+	uint32_t fields_generation;
 	uint32_t *fields_chains;
+	uint64_t hash_seed[2];
+
+	// The indexes take up room in the fields array
+	size_t object_indexes_capacity;
 	size_t fields_capacity;
+
+	// Every key, including the ones that the projection leaves out, which are still checked for duplicates
+	size_t keys_capacity;
 	size_t fields_size;
-} *g;
 
-static size_t recursion_depth;
+	// The open arrays and objects, with the innermost one at the lowest address
+	struct frame *frames_end;
+	size_t frames_capacity;
+	size_t frames_size;
+
+	// The children of the open arrays and objects, until they get closed
+	struct json_node *child_nodes;
+	size_t child_nodes_size;
+	struct json_field *child_fields;
+	size_t child_fields_size;
+
+	bool seen_root;
+	struct json_node root;
+
+	// Only json_feed() and json_sax() call the callbacks, and a tape or index doesn't build a tree
+	struct json_callbacks *callbacks;
+	bool builds_tree;
+
+	bool builds_tape;
+	uint64_t *tape;
+	size_t tape_capacity;
+	size_t tape_size;
+
+	// The string offsets on the tape are relative to this
+	char *tape_strings;
+
+	// json_index() leaves its strings and numbers in the text until a cursor reaches them
+	bool defers_values;
+
+	// json_feed() keeps its keys and strings on a byte stack instead of in the text
+	bool feeds_chunks;
+
+	char *feed_bytes;
+	size_t feed_bytes_size;
+	size_t feed_capacity;
+	size_t feed_bytes_offset;
+	bool feed_in_string;
+	bool feed_in_escape;
+	bool feed_string_has_escape;
+	size_t feed_string_start;
+	bool feed_in_scalar;
+	size_t feed_scalar_start;
+	enum json_status feed_status;
+
+	// The file that json_sax() is feeding, so it can be closed when the text turns out to be invalid
+	FILE *sax_file;
+};
+
+static struct json_callbacks no_callbacks;
 
-static struct json_node parse_string(size_t *i);
-static struct json_node parse_array(size_t *i);
+// The context of the buffer that the current thread is using
+static _Thread_local struct context *g;
+
+static struct token *peek_token(void);
+static void next_token(void);
+static void check_feed_space(size_t byte_count);
+static void check_feed_duplicate_keys(struct frame *frame);
 
 static void push_node(struct json_node node) {
-	if (g->nodes_size + 1 > g->nodes_capacity) {
-		g->nodes_capacity *= 2;
-		json_error(JSON_RESTART);
+	if (g->builds_tree) {
+		g->nodes[g->nodes_size++] = node;
 	}
-
-	g->nodes[g->nodes_size++] = node;
 }
 
 static void push_field(struct json_field field) {
-	if (g->fields_size + 1 > g->fields_capacity) {
-		g->fields_capacity *= 2;
-		json_error(JSON_RESTART);
+	if (g->builds_tree) {
+		g->fields[g->fields_size++] = field;
 	}
+}
 
-	g->fields[g->fields_size++] = field;
+static void push_tape_word(char tag, uint64_t payload) {
+	if (g->builds_tape && !g->skips_value) {
+		g->tape[g->tape_size++] = (uint64_t)tag << TAPE_TAG_SHIFT | payload;
+	}
 }
 
-static char *push_string(char *slice_start, size_t length) {
-	if (g->strings_size + length + 1 > g->strings_capacity) {
-		g->strings_capacity *= 2;
-		json_error(JSON_RESTART);
+// A deferred string points at its opening '"' in the text instead
+static void push_tape_string(char *str) {
+	if (g->defers_values) {
+		push_tape_word('s', str - g->text);
+	} else {
+		push_tape_word('"', str - g->tape_strings);
 	}
+}
 
-	char *new_str = g->strings + g->strings_size;
+// A number doesn't fit in a payload, so its bits are stored in the next word
+// A deferred number points at its first character in the text instead
+static void push_tape_number(struct token *token) {
+	if (g->defers_values) {
+		push_tape_word('#', token->str - g->text);
+	} else if (g->builds_tape && !g->skips_value) {
+		push_tape_word('d', 0);
+		memcpy(g->tape + g->tape_size++, &token->number, sizeof(token->number));
+	}
+}
+
+// Points the container's opening word past its closing word,
+// and stores the number of children in the closing word
+static void close_tape_container(struct frame *frame, char tag) {
+	if (g->builds_tape && !g->skips_value) {
+		g->tape[frame->tape_index] |= g->tape_size + 1;
+		push_tape_word(tag, frame->child_count);
+	}
+}
+
+// A callback can itself call into this library, which points g at another buffer,
+// so g is restored once the callback returns
+static void emit(void (*callback)(void *user_data)) {
+	if (callback && !g->skips_value) {
+		struct context *context = g;
+		callback(g->callbacks->user_data);
+		g = context;
+	}
+}
+
+static void emit_string(void (*callback)(void *user_data, char *string), char *string) {
+	if (callback && !g->skips_value) {
+		struct context *context = g;
+		callback(g->callbacks->user_data, string);
+		g = context;
+	}
+}
+
+static void emit_number(double number) {
+	if (g->callbacks->on_number && !g->skips_value) {
+		struct context *context = g;
+		g->callbacks->on_number(g->callbacks->user_data, number);
+		g = context;
+	}
+}
 
-	for (size_t i = 0; i < length; i++) {
-		g->strings[g->strings_size++] = slice_start[i];
+static void emit_bool(bool boolean) {
+	if (g->callbacks->on_bool && !g->skips_value) {
+		struct context *context = g;
+		g->callbacks->on_bool(g->callbacks->user_data, boolean);
+		g = context;
 	}
-	g->strings[g->strings_size++] = '\0';
+}
+
+static char *push_string(const char *slice_start, size_t length) {
+	char *new_str = g->strings + g->strings_size;
+
+	memcpy(new_str, slice_start, length);
+	new_str[length] = '\0';
+
+	g->strings_size += length + 1;
 
 	return new_str;
 }
 
-// From https://sourceware.org/git/?p=binutils-gdb.git;a=blob;f=bfd/elf.c#l193
-static uint32_t elf_hash(const char *namearg) {
-	uint32_t h = 0;
+#define ROTATE_LEFT(x, bits) (((x) << (bits)) | ((x) >> (64 - (bits))))
+
+static void sip_round(uint64_t *v) {
+	v[0] += v[1];
+	v[1] = ROTATE_LEFT(v[1], 13);
+	v[1] ^= v[0];
+	v[0] = ROTATE_LEFT(v[0], 32);
+	v[2] += v[3];
+	v[3] = ROTATE_LEFT(v[3], 16);
+	v[3] ^= v[2];
+	v[0] += v[3];
+	v[3] = ROTATE_LEFT(v[3], 21);
+	v[3] ^= v[0];
+	v[2] += v[1];
+	v[1] = ROTATE_LEFT(v[1], 17);
+	v[1] ^= v[2];
+	v[2] = ROTATE_LEFT(v[2], 32);
+}
+
+// SipHash-1-3, from https://github.com/veorq/SipHash
+// Since it's keyed with the secret seed from json_init(),
+// keys can't be crafted to all end up in the same bucket
+static uint64_t hash_key(const char *key, const uint64_t *seed) {
+	uint64_t v[4] = {
+		0x736f6d6570736575 ^ seed[0],
+		0x646f72616e646f6d ^ seed[1],
+		0x6c7967656e657261 ^ seed[0],
+		0x7465646279746573 ^ seed[1],
+	};
+
+	size_t length = strlen(key);
+
+	size_t i = 0;
+	for (; i + 8 <= length; i += 8) {
+		uint64_t word;
+		memcpy(&word, key + i, sizeof(word));
+
+		v[3] ^= word;
+		sip_round(v);
+		v[0] ^= word;
+	}
 
-	for (const unsigned char *name = (const unsigned char *) namearg; *name; name++) {
-		h = (h << 4) + *name;
-		h ^= (h >> 24) & 0xf0;
+	uint64_t last_word = (uint64_t)length << 56;
+	for (size_t j = 0; i + j < length; j++) {
+		last_word |= (uint64_t)(unsigned char)key[i + j] << (8 * j);
 	}
 
-	return h & 0x0fffffff;
+	v[3] ^= last_word;
+	sip_round(v);
+	v[0] ^= last_word;
+
+	v[2] ^= 0xff;
+	sip_round(v);
+	sip_round(v);
+	sip_round(v);
+
+	return v[0] ^ v[1] ^ v[2] ^ v[3];
 }
 
-static bool is_duplicate_key(struct json_field *child_fields, size_t field_count, char *key) {
-	uint32_t i = g->fields_buckets[elf_hash(key) % field_count];
+// The smallest power of two that fits every field,
+// so a hash can be turned into a bucket index with a mask instead of a division
+static size_t get_bucket_count(size_t field_count) {
+	size_t bucket_count = 1;
+	while (bucket_count < field_count) {
+		bucket_count *= 2;
+	}
+	return bucket_count;
+}
+
+// Returns the index of the first field in the bucket's chain,
+// where a bucket that was stamped with an older generation counts as empty
+static uint32_t get_bucket_head(size_t bucket_index) {
+	struct bucket bucket = g->fields_buckets[bucket_index];
+
+	if (bucket.generation != g->fields_generation) {
+		return UINT32_MAX;
+	}
+
+	return bucket.field_index;
+}
 
+static bool is_duplicate_key(struct json_field *child_fields, uint32_t i, char *key) {
 	while (1) {
 		if (i == UINT32_MAX) {
 			return false;
@@ -136,410 +492,3252 @@ static bool is_duplicate_key(struct json_field *child_fields, size_t field_count
 	return true;
 }
 
-static void check_duplicate_keys(struct json_field *child_fields, size_t field_count) {
-	memset(g->fields_buckets, 0xff, field_count * sizeof(*g->fields_buckets));
-
-	size_t chains_size = 0;
+// Comparing every pair of keys is cheaper than hashing them when there are only a few,
+// and most pairs are told apart by their lengths or first characters
+static void check_duplicate_keys_directly(struct json_field *child_fields, size_t field_count) {
+	size_t lengths[MAX_DIRECTLY_COMPARED_FIELDS];
 
 	for (size_t i = 0; i < field_count; i++) {
 		char *key = child_fields[i].key;
 
-		json_assert(!is_duplicate_key(child_fields, field_count, key), JSON_DUPLICATE_KEY);
-
-		uint32_t bucket_index = elf_hash(key) % field_count;
+		lengths[i] = strlen(key);
 
-		g->fields_chains[chains_size++] = g->fields_buckets[bucket_index];
+		for (size_t j = 0; j < i; j++) {
+			char *other_key = child_fields[j].key;
 
-		g->fields_buckets[bucket_index] = i;
+			json_assert(lengths[j] != lengths[i] || other_key[0] != key[0] || memcmp(other_key, key, lengths[i]) != 0, JSON_DUPLICATE_KEY);
+		}
 	}
 }
 
-static struct json_node parse_object(size_t *i) {
-	struct json_node node;
+// Instead of clearing the buckets before every object,
+// every object stamps the buckets it uses with a new generation
+static void start_fields_generation(void) {
+	g->fields_generation++;
 
-	node.type = JSON_NODE_OBJECT;
-	(*i)++;
-
-	recursion_depth++;
-	json_assert(recursion_depth <= MAX_RECURSION_DEPTH, JSON_MAX_RECURSION_DEPTH_EXCEEDED);
-
-	node.object.field_count = 0;
-
-	struct json_field child_fields[MAX_CHILD_NODES];
-
-	bool seen_key = false;
-	bool seen_colon = false;
-	bool seen_value = false;
-	bool seen_comma = false;
-
-	struct json_field field;
-
-	struct json_node string;
-	struct json_node array;
-	struct json_node object;
-
-	while (*i < g->tokens_size) {
-		struct token *token = g->tokens + *i;
-
-		switch (token->type) {
-		case TOKEN_TYPE_STRING:
-			if (!seen_key) {
-				seen_key = true;
-				field.key = token->str;
-				(*i)++;
-			} else if (seen_colon && !seen_value) {
-				seen_value = true;
-				seen_comma = false;
-				string = parse_string(i);
-				field.value = g->nodes + g->nodes_size;
-				push_node(string);
-				json_assert(node.object.field_count < MAX_CHILD_NODES, JSON_TOO_MANY_CHILD_NODES);
-				child_fields[node.object.field_count++] = field;
-			} else {
-				json_error(JSON_UNEXPECTED_STRING);
-			}
-			break;
-		case TOKEN_TYPE_ARRAY_OPEN:
-			if (seen_colon && !seen_value) {
-				seen_value = true;
-				seen_comma = false;
-				array = parse_array(i);
-				field.value = g->nodes + g->nodes_size;
-				push_node(array);
-				json_assert(node.object.field_count < MAX_CHILD_NODES, JSON_TOO_MANY_CHILD_NODES);
-				child_fields[node.object.field_count++] = field;
-			} else {
-				json_error(JSON_UNEXPECTED_ARRAY_OPEN);
-			}
-			break;
-		case TOKEN_TYPE_ARRAY_CLOSE:
-			json_error(JSON_UNEXPECTED_ARRAY_CLOSE);
-		case TOKEN_TYPE_OBJECT_OPEN:
-			if (seen_colon && !seen_value) {
-				seen_value = true;
-				seen_comma = false;
-				object = parse_object(i);
-				field.value = g->nodes + g->nodes_size;
-				push_node(object);
-				json_assert(node.object.field_count < MAX_CHILD_NODES, JSON_TOO_MANY_CHILD_NODES);
-				child_fields[node.object.field_count++] = field;
-			} else {
-				json_error(JSON_UNEXPECTED_OBJECT_OPEN);
-			}
-			break;
-		case TOKEN_TYPE_OBJECT_CLOSE:
-			if (seen_key && !seen_colon) {
-				json_error(JSON_EXPECTED_COLON);
-			} else if (seen_colon && !seen_value) {
-				json_error(JSON_EXPECTED_VALUE);
-			} else if (seen_comma) {
-				json_error(JSON_TRAILING_COMMA);
-			}
-			node.object.fields = g->fields + g->fields_size;
-			for (size_t field_index = 0; field_index < node.object.field_count; field_index++) {
-				push_field(child_fields[field_index]);
-			}
-			check_duplicate_keys(child_fields, node.object.field_count);
-			(*i)++;
-			recursion_depth--;
-			return node;
-		case TOKEN_TYPE_COMMA:
-			json_assert(seen_value, JSON_UNEXPECTED_COMMA);
-			seen_key = false;
-			seen_colon = false;
-			seen_value = false;
-			seen_comma = true;
-			(*i)++;
-			break;
-		case TOKEN_TYPE_COLON:
-			json_assert(seen_key, JSON_UNEXPECTED_COLON);
-			seen_colon = true;
-			(*i)++;
-			break;
-		}
+	// After the generation wraps around, old stamps could match it
+	if (g->fields_generation == 0) {
+		memset(g->fields_buckets, 0, g->fields_buckets_capacity * sizeof(*g->fields_buckets));
+		g->fields_generation = 1;
 	}
-
-	json_error(JSON_EXPECTED_OBJECT_CLOSE);
 }
 
-static struct json_node parse_array(size_t *i) {
-	struct json_node node;
+static void check_duplicate_keys(struct json_field *child_fields, size_t field_count) {
+	if (field_count <= MAX_DIRECTLY_COMPARED_FIELDS) {
+		check_duplicate_keys_directly(child_fields, field_count);
+		return;
+	}
 
-	node.type = JSON_NODE_ARRAY;
-	(*i)++;
+	start_fields_generation();
 
-	recursion_depth++;
-	json_assert(recursion_depth <= MAX_RECURSION_DEPTH, JSON_MAX_RECURSION_DEPTH_EXCEEDED);
+	size_t bucket_mask = get_bucket_count(field_count) - 1;
 
-	node.array.value_count = 0;
+	for (size_t i = 0; i < field_count; i++) {
+		char *key = child_fields[i].key;
 
-	struct json_node child_nodes[MAX_CHILD_NODES];
+		size_t bucket_index = hash_key(key, g->hash_seed) & bucket_mask;
 
-	bool seen_value = false;
-	bool seen_comma = false;
+		uint32_t head = get_bucket_head(bucket_index);
 
-	while (*i < g->tokens_size) {
-		struct token *token = g->tokens + *i;
+		json_assert(!is_duplicate_key(child_fields, head, key), JSON_DUPLICATE_KEY);
 
-		switch (token->type) {
-		case TOKEN_TYPE_STRING:
-			json_assert(!seen_value, JSON_UNEXPECTED_STRING);
-			seen_value = true;
-			seen_comma = false;
-			json_assert(node.array.value_count < MAX_CHILD_NODES, JSON_TOO_MANY_CHILD_NODES);
-			child_nodes[node.array.value_count++] = parse_string(i);
-			break;
-		case TOKEN_TYPE_ARRAY_OPEN:
-			json_assert(!seen_value, JSON_UNEXPECTED_ARRAY_OPEN);
-			seen_value = true;
-			seen_comma = false;
-			json_assert(node.array.value_count < MAX_CHILD_NODES, JSON_TOO_MANY_CHILD_NODES);
-			child_nodes[node.array.value_count++] = parse_array(i);
-			break;
-		case TOKEN_TYPE_ARRAY_CLOSE:
-			json_assert(!seen_comma, JSON_TRAILING_COMMA);
-			node.array.values = g->nodes + g->nodes_size;
-			for (size_t value_index = 0; value_index < node.array.value_count; value_index++) {
-				push_node(child_nodes[value_index]);
-			}
-			(*i)++;
-			recursion_depth--;
-			return node;
-		case TOKEN_TYPE_OBJECT_OPEN:
-			json_assert(!seen_value, JSON_UNEXPECTED_OBJECT_OPEN);
-			seen_value = true;
-			seen_comma = false;
-			json_assert(node.array.value_count < MAX_CHILD_NODES, JSON_TOO_MANY_CHILD_NODES);
-			child_nodes[node.array.value_count++] = parse_object(i);
-			break;
-		case TOKEN_TYPE_OBJECT_CLOSE:
-			json_error(JSON_UNEXPECTED_OBJECT_CLOSE);
-		case TOKEN_TYPE_COMMA:
-			json_assert(seen_value, JSON_UNEXPECTED_COMMA);
-			seen_value = false;
-			seen_comma = true;
-			(*i)++;
-			break;
-		case TOKEN_TYPE_COLON:
-			json_error(JSON_UNEXPECTED_COLON);
-		}
+		g->fields_chains[i] = head;
+
+		g->fields_buckets[bucket_index] = (struct bucket){
+			.generation = g->fields_generation,
+			.field_index = i,
+		};
 	}
+}
 
-	json_error(JSON_EXPECTED_ARRAY_CLOSE);
+// Rounded up to a whole number of fields, since the index is put in the fields array
+static size_t get_object_index_size(size_t field_count) {
+	size_t size = sizeof(struct json_object_index) + (get_bucket_count(field_count) + field_count) * sizeof(uint32_t);
+	return size + (sizeof(struct json_field) - size % sizeof(struct json_field)) % sizeof(struct json_field);
 }
 
-static struct json_node parse_string(size_t *i) {
-	struct json_node node;
+// Only objects with more than MAX_DIRECTLY_COMPARED_FIELDS fields have an index,
+// and only when the parser put them there, so anything else is searched directly
+static struct json_object_index *get_object_index(struct json_object *object) {
+	if (object->field_count <= MAX_DIRECTLY_COMPARED_FIELDS) {
+		return NULL;
+	}
 
-	node.type = JSON_NODE_STRING;
+	struct json_object_index *index = (void *)((char *)object->fields - get_object_index_size(object->field_count));
+	if (index->fields != object->fields || index->field_count != object->field_count) {
+		return NULL;
+	}
+	return index;
+}
 
-	struct token *token = g->tokens + *i;
-	node.string = token->str;
+// Keeps the hash table that check_duplicate_keys() just built for the object,
+// right where its fields are about to be pushed
+static void push_object_index(size_t field_count) {
+	struct json_object_index *index = (void *)(g->fields + g->fields_size);
+	g->fields_size += get_object_index_size(field_count) / sizeof(struct json_field);
 
-	(*i)++;
+	size_t bucket_count = get_bucket_count(field_count);
 
-	return node;
-}
+	index->fields = g->fields + g->fields_size;
+	index->field_count = field_count;
+	memcpy(index->hash_seed, g->hash_seed, sizeof(index->hash_seed));
+	index->bucket_mask = bucket_count - 1;
 
-static struct json_node parse(size_t *i) {
-	struct token *t = g->tokens + *i;
-	struct json_node node;
+	for (size_t bucket_index = 0; bucket_index < bucket_count; bucket_index++) {
+		index->slots[bucket_index] = get_bucket_head(bucket_index);
+	}
+	memcpy(index->slots + bucket_count, g->fields_chains, field_count * sizeof(*g->fields_chains));
+}
 
-	switch (t->type) {
-	case TOKEN_TYPE_STRING:
-		node = parse_string(i);
-		break;
-	case TOKEN_TYPE_ARRAY_OPEN:
-		node = parse_array(i);
-		break;
-	case TOKEN_TYPE_ARRAY_CLOSE:
-		json_error(JSON_UNEXPECTED_ARRAY_CLOSE);
-	case TOKEN_TYPE_OBJECT_OPEN:
-		node = parse_object(i);
-		break;
-	case TOKEN_TYPE_OBJECT_CLOSE:
-		json_error(JSON_UNEXPECTED_OBJECT_CLOSE);
-	case TOKEN_TYPE_COMMA:
-		json_error(JSON_UNEXPECTED_COMMA);
-	case TOKEN_TYPE_COLON:
-		json_error(JSON_UNEXPECTED_COLON);
+// Returns the step after the one that the path is at, where a step is either ".key" or "[*]"
+static const char *skip_projection_step(const char *step) {
+	if (*step == '[') {
+		return step + 3;
 	}
 
-	json_assert(*i >= g->tokens_size, JSON_UNEXPECTED_EXTRA_CHARACTER);
+	step++;
+	while (*step != '\0' && *step != '.' && *step != '[') {
+		step++;
+	}
+	return step;
+}
 
-	return node;
+static bool is_projection_step_end(char c) {
+	return c == '\0' || c == '.' || c == '[';
 }
 
-static void push_token(enum token_type type, size_t offset, size_t length) {
-	if (g->tokens_size + 1 > g->tokens_capacity) {
-		g->tokens_capacity *= 2;
-		json_error(JSON_RESTART);
+// Returns where the step ends when it matches the key, or the index of an array's value when the key is NULL,
+// and NULL when it doesn't
+// The key is compared while the step is walked, so a key that differs in its first character is rejected right away
+// ".*" matches every key
+static const char *match_projection_step(const char *step, const char *key, size_t key_length) {
+	if (!key) {
+		return *step == '[' ? step + 3 : NULL;
+	}
+	if (*step != '.') {
+		return NULL;
 	}
+	step++;
 
-	g->tokens[g->tokens_size++] = (struct token){
-		.type = type,
-		.str = push_string(g->text + offset, length),
-	};
-}
+	if (*step == '*' && is_projection_step_end(step[1])) {
+		return step + 1;
+	}
+
+	// A key_length of SIZE_MAX means the key is null-terminated
+	if (key_length == SIZE_MAX) {
+		while (!is_projection_step_end(*step) && *step == *key) {
+			step++;
+			key++;
+		}
+		return is_projection_step_end(*step) && *key == '\0' ? step : NULL;
+	}
 
-static void tokenize(void) {
 	size_t i = 0;
+	while (i < key_length && !is_projection_step_end(step[i]) && step[i] == key[i]) {
+		i++;
+	}
+	return i == key_length && is_projection_step_end(step[i]) ? step + i : NULL;
+}
 
-	while (i < g->text_size) {
-		if (g->text[i] == '"') {
-			size_t string_start_index = i;
+// Moves every path to its step for the children of the arrays and objects at the depth
+// The keys of an object are all at the same depth, so the paths mostly don't move,
+// and going up starts over from the '$' of each path
+static void move_projection_steps(size_t depth) {
+	if (depth < g->projection_steps_depth) {
+		for (size_t path_index = 0; path_index < g->projection_path_count; path_index++) {
+			// Skips the '$'
+			g->projection_steps[path_index] = 1;
+		}
+		g->projection_steps_depth = 1;
+	}
 
-			while (++i < g->text_size && g->text[i] != '"') {}
-
-			json_assert(g->text[i] == '"', JSON_UNCLOSED_STRING);
-
-			push_token(
-				TOKEN_TYPE_STRING,
-				string_start_index + 1,
-				i - string_start_index - 1
-			);
-		} else if (g->text[i] == '[') {
-			push_token(TOKEN_TYPE_ARRAY_OPEN, i, 1);
-		} else if (g->text[i] == ']') {
-			push_token(TOKEN_TYPE_ARRAY_CLOSE, i, 1);
-		} else if (g->text[i] == '{') {
-			push_token(TOKEN_TYPE_OBJECT_OPEN, i, 1);
-		} else if (g->text[i] == '}') {
-			push_token(TOKEN_TYPE_OBJECT_CLOSE, i, 1);
-		} else if (g->text[i] == ',') {
-			push_token(TOKEN_TYPE_COMMA, i, 1);
-		} else if (g->text[i] == ':') {
-			push_token(TOKEN_TYPE_COLON, i, 1);
-		} else if (!isspace(g->text[i])) {
-			json_error(JSON_UNRECOGNIZED_CHARACTER);
+	for (; g->projection_steps_depth < depth; g->projection_steps_depth++) {
+		for (size_t path_index = 0; path_index < g->projection_path_count; path_index++) {
+			const char *path = g->projection_paths[path_index];
+			const char *step = path + g->projection_steps[path_index];
+
+			// A path that already ended can't lead any deeper
+			if (*step != '\0') {
+				g->projection_steps[path_index] = skip_projection_step(step) - path;
+			}
 		}
-		i++;
 	}
 }
 
-static void read_text(char *json_file_path) {
-	FILE *f = fopen(json_file_path, "r");
-	json_assert(f, JSON_FAILED_TO_OPEN_FILE);
-
-	g->text_size = fread(
-		g->text,
-		sizeof(char),
-		g->text_capacity,
-		f
-	);
+static struct projection project_paths(struct projection parent, size_t depth, const char *key, size_t key_length) {
+	if (depth != g->projection_steps_depth) {
+		move_projection_steps(depth);
+	}
 
-	int is_eof = feof(f);
-	int err = ferror(f);
+	struct projection child = {0};
 
-	json_assert(fclose(f) == 0, JSON_FAILED_TO_CLOSE_FILE);
+	// Only the paths that lead to the parent are compared
+	for (uint64_t paths = parent.paths; paths != 0; paths &= paths - 1) {
+		size_t path_index = __builtin_ctzll(paths);
 
-	json_assert(g->text_size != 0, JSON_FILE_EMPTY);
+		const char *step_end = match_projection_step(g->projection_paths[path_index] + g->projection_steps[path_index], key, key_length);
 
-	if (!is_eof) {
-		g->text_capacity *= 2;
-		json_error(JSON_RESTART);
+		if (step_end) {
+			if (*step_end == '\0') {
+				child.is_kept = true;
+			} else {
+				child.paths |= 1ULL << path_index;
+			}
+		}
 	}
 
-	json_assert(err == 0, JSON_FILE_READING_ERROR);
+	return child;
 }
 
-static void check_if_out_of_memory(size_t size, size_t capacity) {
-	if (size > capacity) {
-		json_error(JSON_OUT_OF_MEMORY);
+// The key doesn't have to be null-terminated, which lets the counting pass use the keys in the text,
+// while a key_length of SIZE_MAX means it is, which saves the parser from calling strlen() on every key
+// Most values are either kept entirely or left out entirely, so that is checked before any path is looked at
+static struct projection project_key(struct projection parent, size_t depth, const char *key, size_t key_length) {
+	if (parent.is_kept || parent.paths == 0) {
+		return parent;
 	}
+	return project_paths(parent, depth, key, key_length);
 }
 
-// Used to align to 16 bytes
-static size_t get_padding(size_t n) {
-	return (16 - (n % 16)) % 16;
+// Works out which of the paths that lead to the parent also lead to its child with the key,
+// where depth is the number of arrays and objects that the child is in
+static struct projection project_child(struct projection parent, size_t depth, const char *key) {
+	return project_key(parent, depth, key, SIZE_MAX);
 }
 
-static void *get_next_aligned_area(size_t *size) {
-	*size += get_padding(*size);
-	return (char *)g + *size;
+static bool is_projected_out(struct projection projection) {
+	return !projection.is_kept && projection.paths == 0;
 }
 
-static void allocate_arrays(size_t capacity, size_t padding) {
-	g->text_size = 0;
-	g->tokens_size = 0;
-	g->nodes_size = 0;
-	g->strings_size = 0;
-	g->fields_size = 0;
+static struct projection get_root_projection(void) {
+	struct projection root = {.is_kept = g->projection_path_count == 0};
 
-	// Reserve space for the g struct itself in the buffer
-	size_t size = padding + sizeof(*g);
-	check_if_out_of_memory(size, capacity);
+	for (size_t path_index = 0; path_index < g->projection_path_count; path_index++) {
+		// The path "$" keeps the whole document
+		if (g->projection_paths[path_index][1] == '\0') {
+			root.is_kept = true;
+		}
+		root.paths |= 1ULL << path_index;
+	}
 
-	g->text = get_next_aligned_area(&size);
-	size += g->text_capacity * sizeof(*g->text);
-	check_if_out_of_memory(size, capacity);
+	return root;
+}
 
-	g->tokens = get_next_aligned_area(&size);
-	size += g->tokens_capacity * sizeof(*g->tokens);
-	check_if_out_of_memory(size, capacity);
+static void use_value_projection(struct projection projection) {
+	g->value_projection = projection;
+	g->skips_value = is_projected_out(projection);
+}
 
-	g->nodes = get_next_aligned_area(&size);
-	size += g->nodes_capacity * sizeof(*g->nodes);
-	check_if_out_of_memory(size, capacity);
+static struct frame *get_frame(void) {
+	return g->frames_end - g->frames_size;
+}
 
-	g->strings = get_next_aligned_area(&size);
-	size += g->strings_capacity * sizeof(*g->strings);
-	check_if_out_of_memory(size, capacity);
+// Opens an array or object
+static void push_frame(bool is_object) {
+	size_t children_start;
 
-	g->fields = get_next_aligned_area(&size);
-	size += g->fields_capacity * sizeof(*g->fields);
-	check_if_out_of_memory(size, capacity);
+	if (g->feeds_chunks) {
+		check_feed_space(sizeof(struct frame));
+		children_start = g->feed_bytes_size;
+	} else {
+		children_start = is_object ? g->child_fields_size : g->child_nodes_size;
+	}
 
-	g->fields_buckets = get_next_aligned_area(&size);
-	size += g->fields_capacity * sizeof(*g->fields_buckets);
-	check_if_out_of_memory(size, capacity);
+	g->frames_size++;
 
-	g->fields_chains = get_next_aligned_area(&size);
-	size += g->fields_capacity * sizeof(*g->fields_chains);
-	check_if_out_of_memory(size, capacity);
+	*get_frame() = (struct frame){
+		.is_object = is_object,
+		.children_start = children_start,
+		.tape_index = g->tape_size,
+		.projection = g->value_projection,
+	};
+
+	// The payload is filled in once the array or object is closed
+	push_tape_word(is_object ? '{' : '[', 0);
 }
 
-enum json_status json(char *json_file_path, struct json_node *returned, void *buffer, size_t buffer_capacity) {
-	enum json_status status = setjmp(error_jmp_buffer);
-	if (status && status != JSON_RESTART) {
-		return status;
+// Checks that a value is allowed here, and counts it as a child of the open array or object
+static void begin_value(enum token_type type) {
+	if (g->frames_size == 0) {
+		json_assert(!g->seen_root, JSON_UNEXPECTED_EXTRA_CHARACTER);
+		g->seen_root = true;
+		use_value_projection(g->root_projection);
+		return;
 	}
 
-	size_t padding = get_padding((size_t)buffer);
-	g = (void *)(padding + (char *)buffer);
-
-	allocate_arrays(buffer_capacity, padding);
-
-	read_text(json_file_path);
-
-	tokenize();
+	struct frame *frame = get_frame();
+
+	if (frame->is_object ? !(frame->seen_colon && !frame->seen_value) : frame->seen_value) {
+		if (type == TOKEN_TYPE_STRING) {
+			json_error(JSON_UNEXPECTED_STRING);
+		} else if (type == TOKEN_TYPE_ARRAY_OPEN) {
+			json_error(JSON_UNEXPECTED_ARRAY_OPEN);
+		} else if (type == TOKEN_TYPE_OBJECT_OPEN) {
+			json_error(JSON_UNEXPECTED_OBJECT_OPEN);
+		} else if (type == TOKEN_TYPE_NUMBER) {
+			json_error(JSON_UNEXPECTED_NUMBER);
+		}
+		json_error(JSON_UNEXPECTED_LITERAL);
+	}
 
-	recursion_depth = 0;
+	frame->seen_value = true;
+	frame->seen_comma = false;
 
-	size_t token_index = 0;
-	*returned = parse(&token_index);
+	// An object's key already decided which paths its value can lead to
+	use_value_projection(frame->is_object ? frame->value_projection : project_child(frame->projection, g->frames_size, NULL));
 
-	return JSON_OK;
+	if (!g->skips_value) {
+		frame->child_count++;
+	}
 }
 
-bool json_init(void *buffer, size_t buffer_capacity) {
-	size_t padding = get_padding((size_t)buffer);
+// Hands a finished value to the open array or object, or makes it the root
+// An object's values are pushed right away, since its fields point to them,
+// but an array's values have to wait on the children stack until the array is closed,
+// since they have to end up next to each other
+static void end_value(struct json_node node) {
+	// A json_feed() has nowhere to put values
+	if (g->feeds_chunks) {
+		return;
+	}
 
-	if (buffer_capacity < padding + sizeof(*g)) {
-		return true;
+	if (g->frames_size == 0) {
+		if (!g->skips_value) {
+			g->root = node;
+		}
+		return;
 	}
 
-	g = (void *)(padding + (char *)buffer);
+	struct frame *frame = get_frame();
+
+	// The key of a value that the projection leaves out is only kept for the duplicate key check
+	if (g->skips_value) {
+		if (frame->is_object) {
+			g->child_fields[g->child_fields_size++] = (struct json_field){.key = frame->key};
+		}
+		return;
+	}
+
+	if (frame->is_object) {
+		g->child_fields[g->child_fields_size++] = (struct json_field){
+			.key = frame->key,
+			.value = g->nodes + g->nodes_size,
+		};
+		push_node(node);
+	} else if (g->builds_tree) {
+		g->child_nodes[g->child_nodes_size++] = node;
+	}
+}
+
+static void close_array(struct frame *frame) {
+	use_value_projection(frame->projection);
+
+	emit(g->callbacks->on_array_end);
+
+	g->frames_size--;
+
+	if (g->feeds_chunks) {
+		return;
+	}
+
+	close_tape_container(frame, ']');
+
+	struct json_node node;
+
+	node.type = JSON_NODE_ARRAY;
+
+	node.array.values = g->nodes + g->nodes_size;
+	node.array.value_count = frame->child_count;
+
+	// Without a tree the children were never stored
+	if (g->builds_tree) {
+		for (size_t value_index = 0; value_index < node.array.value_count; value_index++) {
+			push_node(g->child_nodes[frame->children_start + value_index]);
+		}
+		g->child_nodes_size = frame->children_start;
+	}
+
+	end_value(node);
+}
+
+static void close_object(struct frame *frame) {
+	use_value_projection(frame->projection);
+
+	if (g->feeds_chunks) {
+		check_feed_duplicate_keys(frame);
+		emit(g->callbacks->on_object_end);
+		g->feed_bytes_size = frame->children_start;
+		g->frames_size--;
+		return;
+	}
+
+	struct json_node node;
+
+	node.type = JSON_NODE_OBJECT;
+
+	struct json_field *child_fields = g->child_fields + frame->children_start;
+	size_t key_count = g->child_fields_size - frame->children_start;
+	size_t field_count = frame->child_count;
+
+	// Deferred keys haven't been lexed, so json_cursor_field() just returns the first one that matches
+	if (!g->defers_values) {
+		check_duplicate_keys(child_fields, key_count);
+	}
+
+	// The fields that the projection left out don't have a value, and don't end up in the tree
+	if (field_count < key_count) {
+		size_t kept_count = 0;
+		for (size_t key_index = 0; key_index < key_count; key_index++) {
+			if (child_fields[key_index].value) {
+				child_fields[kept_count++] = child_fields[key_index];
+			}
+		}
+
+		// The index can only point at the fields that are kept
+		if (g->builds_tree && field_count > MAX_DIRECTLY_COMPARED_FIELDS) {
+			check_duplicate_keys(child_fields, field_count);
+		}
+	}
+
+	// Small objects are searched directly, just like they're checked for duplicate keys
+	if (g->builds_tree && field_count > MAX_DIRECTLY_COMPARED_FIELDS) {
+		push_object_index(field_count);
+	}
+
+	node.object.fields = g->fields + g->fields_size;
+	node.object.field_count = field_count;
+
+	for (size_t field_index = 0; field_index < field_count; field_index++) {
+		push_field(child_fields[field_index]);
+	}
+
+	emit(g->callbacks->on_object_end);
+
+	close_tape_container(frame, '}');
+
+	g->child_fields_size = frame->children_start;
+	g->frames_size--;
+
+	end_value(node);
+}
+
+// Handles one token, so the parser never recurses,
+// and can stop at any token to wait for the next chunk of a json_feed()
+static void parse_token(struct token *token) {
+	struct frame *frame = g->frames_size > 0 ? get_frame() : NULL;
+
+	enum token_type type = token->type;
+	char *str = token->str;
+
+	switch (type) {
+	case TOKEN_TYPE_STRING:
+		if (frame && frame->is_object && !frame->seen_key) {
+			frame->seen_key = true;
+			frame->key = str;
+
+			// The key is only kept when its value is
+			frame->value_projection = project_child(frame->projection, g->frames_size, str);
+			g->skips_value = is_projected_out(frame->value_projection);
+
+			emit_string(g->callbacks->on_key, str);
+			push_tape_string(str);
+
+			// A fed key stays on the byte stack until its object is closed, for the duplicate key check
+			return;
+		}
+		begin_value(type);
+		emit_string(g->callbacks->on_string, str);
+		if (g->feeds_chunks) {
+			g->feed_bytes_size = str - g->feed_bytes;
+		} else {
+			push_tape_string(str);
+			end_value((struct json_node){.type = JSON_NODE_STRING, .string = str});
+		}
+		break;
+	case TOKEN_TYPE_ARRAY_OPEN:
+		begin_value(type);
+		emit(g->callbacks->on_array_start);
+		push_frame(false);
+		break;
+	case TOKEN_TYPE_ARRAY_CLOSE:
+		if (!frame) {
+			json_assert(!g->seen_root, JSON_UNEXPECTED_EXTRA_CHARACTER);
+			json_error(JSON_UNEXPECTED_ARRAY_CLOSE);
+		}
+		json_assert(!frame->is_object, JSON_UNEXPECTED_ARRAY_CLOSE);
+		json_assert(!frame->seen_comma, JSON_TRAILING_COMMA);
+		close_array(frame);
+		break;
+	case TOKEN_TYPE_OBJECT_OPEN:
+		begin_value(type);
+		emit(g->callbacks->on_object_start);
+		push_frame(true);
+		break;
+	case TOKEN_TYPE_OBJECT_CLOSE:
+		if (!frame) {
+			json_assert(!g->seen_root, JSON_UNEXPECTED_EXTRA_CHARACTER);
+			json_error(JSON_UNEXPECTED_OBJECT_CLOSE);
+		}
+		json_assert(frame->is_object, JSON_UNEXPECTED_OBJECT_CLOSE);
+		if (frame->seen_key && !frame->seen_colon) {
+			json_error(JSON_EXPECTED_COLON);
+		} else if (frame->seen_colon && !frame->seen_value) {
+			json_error(JSON_EXPECTED_VALUE);
+		} else if (frame->seen_comma) {
+			json_error(JSON_TRAILING_COMMA);
+		}
+		close_object(frame);
+		break;
+	case TOKEN_TYPE_COMMA:
+		if (!frame) {
+			json_assert(!g->seen_root, JSON_UNEXPECTED_EXTRA_CHARACTER);
+			json_error(JSON_UNEXPECTED_COMMA);
+		}
+		json_assert(frame->seen_value, JSON_UNEXPECTED_COMMA);
+		frame->seen_key = false;
+		frame->seen_colon = false;
+		frame->seen_value = false;
+		frame->seen_comma = true;
+		break;
+	case TOKEN_TYPE_COLON:
+		if (!frame) {
+			json_assert(!g->seen_root, JSON_UNEXPECTED_EXTRA_CHARACTER);
+			json_error(JSON_UNEXPECTED_COLON);
+		}
+		json_assert(frame->is_object && frame->seen_key, JSON_UNEXPECTED_COLON);
+		frame->seen_colon = true;
+		break;
+	case TOKEN_TYPE_NUMBER:
+		begin_value(type);
+		emit_number(token->number);
+		push_tape_number(token);
+		end_value((struct json_node){.type = JSON_NODE_NUMBER, .number = token->number});
+		break;
+	case TOKEN_TYPE_TRUE:
+	case TOKEN_TYPE_FALSE:
+		begin_value(type);
+		emit_bool(type == TOKEN_TYPE_TRUE);
+		push_tape_word(type == TOKEN_TYPE_TRUE ? 't' : 'f', 0);
+		end_value((struct json_node){.type = JSON_NODE_BOOL, .boolean = type == TOKEN_TYPE_TRUE});
+		break;
+	case TOKEN_TYPE_NULL:
+		begin_value(type);
+		emit(g->callbacks->on_null);
+		push_tape_word('n', 0);
+		end_value((struct json_node){.type = JSON_NODE_NULL});
+		break;
+	}
+}
+
+// Called once there are no tokens left
+static void finish_parsing(void) {
+	if (g->frames_size > 0) {
+		json_error(get_frame()->is_object ? JSON_EXPECTED_OBJECT_CLOSE : JSON_EXPECTED_ARRAY_CLOSE);
+	}
+
+	json_assert(g->seen_root, JSON_EXPECTED_VALUE);
+}
+
+static uint32_t parse_hex_digits(const char *str) {
+	uint32_t value = 0;
+
+	for (size_t i = 0; i < 4; i++) {
+		char c = str[i];
+
+		uint32_t digit;
+		if (c >= '0' && c <= '9') {
+			digit = c - '0';
+		} else if (c >= 'a' && c <= 'f') {
+			digit = c - 'a' + 10;
+		} else if (c >= 'A' && c <= 'F') {
+			digit = c - 'A' + 10;
+		} else {
+			json_error(JSON_INVALID_ESCAPE);
+		}
+
+		value = value * 16 + digit;
+	}
+
+	return value;
+}
+
+// Decodes the \uXXXX at str[*i], plus the low surrogate that has to follow a high one,
+// and returns the number of UTF-8 bytes it wrote to out
+static size_t unescape_code_point(const char *str, size_t *i, size_t length, char *out) {
+	json_assert(*i + 4 <= length, JSON_INVALID_ESCAPE);
+	uint32_t code_point = parse_hex_digits(str + *i);
+	*i += 4;
+
+	if (code_point >= 0xd800 && code_point <= 0xdbff) {
+		json_assert(*i + 6 <= length && str[*i] == '\\' && str[*i + 1] == 'u', JSON_INVALID_ESCAPE);
+		uint32_t low_surrogate = parse_hex_digits(str + *i + 2);
+		json_assert(low_surrogate >= 0xdc00 && low_surrogate <= 0xdfff, JSON_INVALID_ESCAPE);
+		*i += 6;
+
+		code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low_surrogate - 0xdc00);
+	} else {
+		json_assert(code_point < 0xdc00 || code_point > 0xdfff, JSON_INVALID_ESCAPE);
+	}
+
+	// The strings are null-terminated, so they can't contain a '\0'
+	json_assert(code_point != 0, JSON_INVALID_ESCAPE);
+
+	if (code_point < 0x80) {
+		out[0] = code_point;
+		return 1;
+	}
+	if (code_point < 0x800) {
+		out[0] = 0xc0 | (code_point >> 6);
+		out[1] = 0x80 | (code_point & 0x3f);
+		return 2;
+	}
+	if (code_point < 0x10000) {
+		out[0] = 0xe0 | (code_point >> 12);
+		out[1] = 0x80 | ((code_point >> 6) & 0x3f);
+		out[2] = 0x80 | (code_point & 0x3f);
+		return 3;
+	}
+	out[0] = 0xf0 | (code_point >> 18);
+	out[1] = 0x80 | ((code_point >> 12) & 0x3f);
+	out[2] = 0x80 | ((code_point >> 6) & 0x3f);
+	out[3] = 0x80 | (code_point & 0x3f);
+	return 4;
+}
+
+// Decodes the escape sequences of a string in place, and returns its new length
+// No escape sequence is shorter than what it decodes to, so the writes never overtake the reads
+// The characters between the escape sequences are moved in bulk
+static size_t unescape_string(char *str, size_t length) {
+	size_t read = 0;
+	size_t written = 0;
+
+	while (true) {
+		char *backslash = memchr(str + read, '\\', length - read);
+		size_t span_end = backslash ? (size_t)(backslash - str) : length;
+
+		memmove(str + written, str + read, span_end - read);
+		written += span_end - read;
+
+		if (!backslash) {
+			return written;
+		}
+
+		// A '\\' always has a character after it, since it would've escaped the closing '"' otherwise
+		char escaped = str[span_end + 1];
+		read = span_end + 2;
+
+		switch (escaped) {
+		case '"':
+		case '\\':
+		case '/':
+			str[written++] = escaped;
+			break;
+		case 'b':
+			str[written++] = '\b';
+			break;
+		case 'f':
+			str[written++] = '\f';
+			break;
+		case 'n':
+			str[written++] = '\n';
+			break;
+		case 'r':
+			str[written++] = '\r';
+			break;
+		case 't':
+			str[written++] = '\t';
+			break;
+		case 'u':
+			written += unescape_code_point(str, &read, length, str + written);
+			break;
+		default:
+			json_error(JSON_INVALID_ESCAPE);
+		}
+	}
+}
+
+// Checks the escape sequences of a string that isn't decoded, without writing anything
+static void check_escapes(const char *str, size_t length) {
+	char code_point[4];
+
+	size_t read = 0;
+	const char *backslash;
+	while ((backslash = memchr(str + read, '\\', length - read))) {
+		read = backslash - str + 2;
+
+		switch (backslash[1]) {
+		case '"':
+		case '\\':
+		case '/':
+		case 'b':
+		case 'f':
+		case 'n':
+		case 'r':
+		case 't':
+			break;
+		case 'u':
+			unescape_code_point(str, &read, length, code_point);
+			break;
+		default:
+			json_error(JSON_INVALID_ESCAPE);
+		}
+	}
+}
+
+// Strings that the projection leaves out are rejected for the same reasons as the others,
+// but aren't copied or decoded
+static void check_skipped_string(size_t offset, size_t length, bool has_escape) {
+	if (g->validates_utf8) {
+		json_assert(g->is_valid_utf8(g->text + offset, length), JSON_INVALID_UTF8);
+	}
+
+	if (has_escape) {
+		check_escapes(g->text + offset, length);
+	}
+}
+
+// Strings without any escape sequences are used as they are
+static char *get_string(size_t offset, size_t length, bool has_escape) {
+	// Escape sequences are ASCII, so the string can be validated before they're decoded
+	if (g->validates_utf8) {
+		json_assert(g->is_valid_utf8(g->text + offset, length), JSON_INVALID_UTF8);
+	}
+
+	char *str;
+
+	if (g->copies_strings) {
+		str = push_string(g->text + offset, length);
+	} else {
+		// The text is in the buffer, so it can be modified
+		str = (char *)g->text + offset;
+	}
+
+	if (has_escape) {
+		size_t unescaped_length = unescape_string(str, length);
+
+		if (g->copies_strings) {
+			g->strings_size -= length - unescaped_length;
+		}
+
+		length = unescaped_length;
+	}
+
+	// This overwrites the closing '"' when the string is in the text
+	str[length] = '\0';
+	return str;
+}
+
+static bool is_whitespace(char c) {
+	return isspace((unsigned char)c);
+}
+
+// The scanners below return the index of the first character at or after i
+// that stops them, or the text size if there is none
+// The vectorized ones handle 16, 32 or 64 characters per step,
+// and leave the last few characters to the scalar ones so they never read past the text
+
+// The characters that json_write() has to escape in strings,
+// which are also the ones that end a run of ordinary characters in a string that's being lexed
+static bool is_escaped_character(char c) {
+	return c == '"' || c == '\\' || (unsigned char)c < 0x20;
+}
+
+static size_t find_escaped_character_scalar(const char *text, size_t i, size_t size) {
+	while (i < size && !is_escaped_character(text[i])) {
+		i++;
+	}
+	return i;
+}
+
+static size_t skip_whitespace_scalar(const char *text, size_t i, size_t size) {
+	while (i < size && is_whitespace(text[i])) {
+		i++;
+	}
+	return i;
+}
+
+// Follows the table of well-formed byte sequences in RFC 3629,
+// which rules out overlong encodings, surrogates and code points above U+10FFFF
+static bool is_valid_utf8_scalar(const char *text, size_t size) {
+	const unsigned char *bytes = (const unsigned char *)text;
+
+	size_t i = 0;
+	while (i < size) {
+		unsigned char c = bytes[i];
+
+		if (c < 0x80) {
+			i++;
+			continue;
+		}
+
+		// The second byte has a narrower range than the other continuation bytes for some leading bytes
+		size_t continuation_count;
+		unsigned char min = 0x80;
+		unsigned char max = 0xbf;
+
+		if (c >= 0xc2 && c <= 0xdf) {
+			continuation_count = 1;
+		} else if (c >= 0xe0 && c <= 0xef) {
+			continuation_count = 2;
+			if (c == 0xe0) {
+				min = 0xa0;
+			} else if (c == 0xed) {
+				max = 0x9f;
+			}
+		} else if (c >= 0xf0 && c <= 0xf4) {
+			continuation_count = 3;
+			if (c == 0xf0) {
+				min = 0x90;
+			} else if (c == 0xf4) {
+				max = 0x8f;
+			}
+		} else {
+			return false;
+		}
+
+		if (size - i - 1 < continuation_count || bytes[i + 1] < min || bytes[i + 1] > max) {
+			return false;
+		}
+
+		for (size_t j = 2; j <= continuation_count; j++) {
+			if ((bytes[i + j] & 0xc0) != 0x80) {
+				return false;
+			}
+		}
+
+		i += continuation_count + 1;
+	}
+
+	return true;
+}
+
+#ifdef __x86_64__
+
+static size_t find_escaped_character_sse2(const char *text, size_t i, size_t size) {
+	__m128i quote = _mm_set1_epi8('"');
+	__m128i backslash = _mm_set1_epi8('\\');
+	__m128i last_control = _mm_set1_epi8(0x1f);
+
+	for (; i + 16 <= size; i += 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i *)(text + i));
+
+		// There is no unsigned comparison, but a byte is at most 0x1f when the minimum of the two is itself
+		__m128i is_control = _mm_cmpeq_epi8(_mm_min_epu8(chunk, last_control), chunk);
+		__m128i is_special = _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+		uint32_t mask = _mm_movemask_epi8(_mm_or_si128(is_special, is_control));
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	return find_escaped_character_scalar(text, i, size);
+}
+
+// isspace() accepts ' ' and '\t' through '\r'
+static size_t skip_whitespace_sse2(const char *text, size_t i, size_t size) {
+	__m128i space = _mm_set1_epi8(' ');
+	__m128i tab = _mm_set1_epi8('\t');
+	__m128i control_range = _mm_set1_epi8('\r' - '\t');
+
+	for (; i + 16 <= size; i += 16) {
+		__m128i chunk = _mm_loadu_si128((const __m128i *)(text + i));
+
+		__m128i control = _mm_sub_epi8(chunk, tab);
+		__m128i is_control = _mm_cmpeq_epi8(_mm_min_epu8(control, control_range), control);
+		__m128i is_whitespace = _mm_or_si128(_mm_cmpeq_epi8(chunk, space), is_control);
+
+		uint32_t mask = ~_mm_movemask_epi8(is_whitespace) & 0xffff;
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	return skip_whitespace_scalar(text, i, size);
+}
+
+// Skips the leading ASCII characters, which make up most strings
+static bool is_valid_utf8_sse2(const char *text, size_t size) {
+	size_t i = 0;
+
+	for (; i + 16 <= size; i += 16) {
+		if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(text + i)))) {
+			break;
+		}
+	}
+
+	return is_valid_utf8_scalar(text + i, size - i);
+}
+
+__attribute__((target("avx2")))
+static size_t find_escaped_character_avx2(const char *text, size_t i, size_t size) {
+	__m256i quote = _mm256_set1_epi8('"');
+	__m256i backslash = _mm256_set1_epi8('\\');
+	__m256i last_control = _mm256_set1_epi8(0x1f);
+
+	for (; i + 32 <= size; i += 32) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i *)(text + i));
+
+		__m256i is_control = _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, last_control), chunk);
+		__m256i is_special = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash));
+		uint32_t mask = _mm256_movemask_epi8(_mm256_or_si256(is_special, is_control));
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	return find_escaped_character_sse2(text, i, size);
+}
+
+__attribute__((target("avx2")))
+static size_t skip_whitespace_avx2(const char *text, size_t i, size_t size) {
+	__m256i space = _mm256_set1_epi8(' ');
+	__m256i tab = _mm256_set1_epi8('\t');
+	__m256i control_range = _mm256_set1_epi8('\r' - '\t');
+
+	for (; i + 32 <= size; i += 32) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i *)(text + i));
+
+		__m256i control = _mm256_sub_epi8(chunk, tab);
+		__m256i is_control = _mm256_cmpeq_epi8(_mm256_min_epu8(control, control_range), control);
+		__m256i is_whitespace = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), is_control);
+
+		uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(is_whitespace);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+
+	return skip_whitespace_sse2(text, i, size);
+}
+
+// The bits of the errors that a pair of bytes can have in the UTF-8 lookup tables below
+#define UTF8_TOO_SHORT (1 << 0)
+#define UTF8_TOO_LONG (1 << 1)
+#define UTF8_OVERLONG_3 (1 << 2)
+#define UTF8_TOO_LARGE (1 << 3)
+#define UTF8_SURROGATE (1 << 4)
+#define UTF8_OVERLONG_2 (1 << 5)
+#define UTF8_TOO_LARGE_1000 (1 << 6)
+#define UTF8_OVERLONG_4 (1 << 6)
+#define UTF8_TWO_CONTINUATIONS (1 << 7)
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTINUATIONS)
+
+// Returns the chunk shifted right by n bytes, with the last n bytes of the previous chunk shifted in
+#define UTF8_PREVIOUS(chunk, previous, n) _mm256_alignr_epi8(chunk, _mm256_permute2x128_si256(previous, chunk, 0x21), 16 - n)
+
+// The errors that are possible for each high nibble of the first byte of a pair
+static const uint8_t utf8_byte_1_high_errors[16] = {
+	// 0_______ ________, an ASCII character followed by a continuation byte
+	UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+	UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+	// 10______ ________
+	UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS, UTF8_TWO_CONTINUATIONS,
+	// 1100____ ________
+	UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+	// 1101____ ________
+	UTF8_TOO_SHORT,
+	// 1110____ ________
+	UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+	// 1111____ ________
+	UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4
+};
+
+// The errors that are possible for each low nibble of the first byte of a pair
+static const uint8_t utf8_byte_1_low_errors[16] = {
+	// ____0000 ________
+	UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+	// ____0001 ________
+	UTF8_CARRY | UTF8_OVERLONG_2,
+	// ____001_ ________
+	UTF8_CARRY,
+	UTF8_CARRY,
+	// ____0100 ________
+	UTF8_CARRY | UTF8_TOO_LARGE,
+	// ____0101 ________ through ____1100 ________
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	// ____1101 ________
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+	// ____111_ ________
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+	UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000
+};
+
+// The errors that are possible for each high nibble of the second byte of a pair
+static const uint8_t utf8_byte_2_high_errors[16] = {
+	// ________ 0_______
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+	// ________ 1000____
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+	// ________ 1001____
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+	// ________ 101_____
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+	UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTINUATIONS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+	// ________ 11______
+	UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT
+};
+
+// Puts the table in both 128-bit lanes, since the shuffle looks up bytes within a lane
+__attribute__((target("avx2")))
+static __m256i get_utf8_table_avx2(const uint8_t *table) {
+	return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)table));
+}
+
+__attribute__((target("avx2")))
+static __m256i get_high_nibbles_avx2(__m256i chunk) {
+	return _mm256_and_si256(_mm256_srli_epi16(chunk, 4), _mm256_set1_epi8(0x0f));
+}
+
+// Every byte of the result has bits set for the errors in the chunk,
+// which is found with three table lookups per pair of adjacent bytes,
+// as described in "Validating UTF-8 In Less Than One Instruction Per Byte" by Keiser and Lemire
+__attribute__((target("avx2")))
+static __m256i get_utf8_errors_avx2(__m256i chunk, __m256i previous) {
+	__m256i previous_1 = UTF8_PREVIOUS(chunk, previous, 1);
+
+	__m256i byte_1_high = _mm256_shuffle_epi8(get_utf8_table_avx2(utf8_byte_1_high_errors), get_high_nibbles_avx2(previous_1));
+
+	__m256i byte_1_low = _mm256_shuffle_epi8(get_utf8_table_avx2(utf8_byte_1_low_errors), _mm256_and_si256(previous_1, _mm256_set1_epi8(0x0f)));
+
+	__m256i byte_2_high = _mm256_shuffle_epi8(get_utf8_table_avx2(utf8_byte_2_high_errors), get_high_nibbles_avx2(chunk));
+
+	__m256i special_cases = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+	// Two continuation bytes in a row are only allowed as the 3rd and 4th bytes of a sequence,
+	// so the top bit is set where a 3 or 4 byte leading byte came 2 or 3 bytes earlier
+	__m256i is_third_byte = _mm256_subs_epu8(UTF8_PREVIOUS(chunk, previous, 2), _mm256_set1_epi8(0xe0 - 0x80));
+	__m256i is_fourth_byte = _mm256_subs_epu8(UTF8_PREVIOUS(chunk, previous, 3), _mm256_set1_epi8(0xf0 - 0x80));
+	__m256i must_be_continuation = _mm256_and_si256(_mm256_or_si256(is_third_byte, is_fourth_byte), _mm256_set1_epi8((char)0x80));
+
+	return _mm256_xor_si256(must_be_continuation, special_cases);
+}
+
+// Returns non-zero bytes if the chunk ends in the middle of a multi-byte sequence
+__attribute__((target("avx2")))
+static __m256i get_utf8_incomplete_avx2(__m256i chunk) {
+	__m256i max = _mm256_setr_epi8(
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xf0 - 1), (char)(0xe0 - 1), (char)(0xc0 - 1)
+	);
+	return _mm256_subs_epu8(chunk, max);
+}
+
+__attribute__((target("avx2")))
+static bool is_valid_utf8_avx2(const char *text, size_t size) {
+	__m256i previous = _mm256_setzero_si256();
+	__m256i errors = _mm256_setzero_si256();
+
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256i chunk = _mm256_loadu_si256((const __m256i *)(text + i));
+
+		// An ASCII chunk only has to check that the previous chunk didn't end in the middle of a sequence
+		if (_mm256_movemask_epi8(chunk) == 0) {
+			errors = _mm256_or_si256(errors, get_utf8_incomplete_avx2(previous));
+		} else {
+			errors = _mm256_or_si256(errors, get_utf8_errors_avx2(chunk, previous));
+		}
+
+		previous = chunk;
+	}
+
+	if (!_mm256_testz_si256(errors, errors)) {
+		return false;
+	}
+
+	// Most strings are shorter than a chunk, so the last few characters are checked one by one,
+	// starting from the leading byte of the last chunk's last sequence, which may not have been finished
+	size_t start = i;
+	while (start > 0 && i - start < 3 && (text[start - 1] & 0xc0) == 0x80) {
+		start--;
+	}
+	if (start > 0 && i - start < 4 && (text[start - 1] & 0xc0) == 0xc0) {
+		start--;
+	}
+
+	// The compiler doesn't clear the upper halves of the registers before tail calls,
+	// which would slow down the SSE code that runs after this function
+	_mm256_zeroupper();
+
+	return is_valid_utf8_scalar(text + start, size - start);
+}
+
+__attribute__((target("avx512bw")))
+static size_t find_escaped_character_avx512(const char *text, size_t i, size_t size) {
+	__m512i quote = _mm512_set1_epi8('"');
+	__m512i backslash = _mm512_set1_epi8('\\');
+	__m512i last_control = _mm512_set1_epi8(0x1f);
+
+	for (; i + 64 <= size; i += 64) {
+		__m512i chunk = _mm512_loadu_si512((const void *)(text + i));
+
+		uint64_t mask = _mm512_cmpeq_epi8_mask(chunk, quote) | _mm512_cmpeq_epi8_mask(chunk, backslash) | _mm512_cmple_epu8_mask(chunk, last_control);
+		if (mask) {
+			return i + __builtin_ctzll(mask);
+		}
+	}
+
+	return find_escaped_character_avx2(text, i, size);
+}
+
+__attribute__((target("avx512bw")))
+static size_t skip_whitespace_avx512(const char *text, size_t i, size_t size) {
+	__m512i space = _mm512_set1_epi8(' ');
+	__m512i tab = _mm512_set1_epi8('\t');
+	__m512i control_range = _mm512_set1_epi8('\r' - '\t');
+
+	for (; i + 64 <= size; i += 64) {
+		__m512i chunk = _mm512_loadu_si512((const void *)(text + i));
+
+		uint64_t is_control = _mm512_cmple_epu8_mask(_mm512_sub_epi8(chunk, tab), control_range);
+		uint64_t mask = ~(_mm512_cmpeq_epi8_mask(chunk, space) | is_control);
+		if (mask) {
+			return i + __builtin_ctzll(mask);
+		}
+	}
+
+	return skip_whitespace_avx2(text, i, size);
+}
+
+static void select_scanners(void) {
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512bw")) {
+		g->find_escaped_character = find_escaped_character_avx512;
+		g->skip_whitespace = skip_whitespace_avx512;
+		g->is_valid_utf8 = is_valid_utf8_avx2;
+	} else if (__builtin_cpu_supports("avx2")) {
+		g->find_escaped_character = find_escaped_character_avx2;
+		g->skip_whitespace = skip_whitespace_avx2;
+		g->is_valid_utf8 = is_valid_utf8_avx2;
+	} else {
+		g->find_escaped_character = find_escaped_character_sse2;
+		g->skip_whitespace = skip_whitespace_sse2;
+		g->is_valid_utf8 = is_valid_utf8_sse2;
+	}
+}
+
+// Every x86-64 CPU has SSE2, so json_write() doesn't need a buffer that json_init() picked the scanners for
+static size_t find_escaped_character(const char *text, size_t i, size_t size) {
+	return find_escaped_character_sse2(text, i, size);
+}
+
+#else
+
+static void select_scanners(void) {
+	g->find_escaped_character = find_escaped_character_scalar;
+	g->skip_whitespace = skip_whitespace_scalar;
+	g->is_valid_utf8 = is_valid_utf8_scalar;
+}
+
+static size_t find_escaped_character(const char *text, size_t i, size_t size) {
+	return find_escaped_character_scalar(text, i, size);
+}
+
+#endif
+
+// Returns the index of the closing '"', or the text size if there is none
+// Every '\\' escapes the character after it, so an escaped '"' doesn't end the string,
+// and a run of backslashes is skipped two at a time
+// JSON doesn't allow control characters in strings, but they're only rejected once the string is lexed,
+// so the counting pass doesn't report them before the errors that come earlier in the text
+static size_t find_string_end(size_t i, bool *has_escape, bool *has_control_character) {
+	i++;
+
+	while (true) {
+		i = g->find_escaped_character(g->text, i, g->text_size);
+
+		if (i >= g->text_size) {
+			return g->text_size;
+		}
+		if (g->text[i] == '"') {
+			return i;
+		}
+
+		if (g->text[i] == '\\') {
+			*has_escape = true;
+			i += 2;
+		} else {
+			*has_control_character = true;
+			i++;
+		}
+	}
+}
+
+// Numbers, true, false and null are made of these characters
+static bool is_scalar_character(char c) {
+	return isalnum((unsigned char)c) || c == '-' || c == '+' || c == '.';
+}
+
+// Returns the index of the first character at or after i that can't be part of a scalar
+static size_t find_scalar_end(const char *text, size_t i, size_t size) {
+	while (i < size && is_scalar_character(text[i])) {
+		i++;
+	}
+	return i;
+}
+
+static bool is_digit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+// Every one of these is exactly representable as a double
+static const double powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// The digits of a number, without its decimal point
+struct decimal {
+	uint64_t mantissa;
+	int significant_digit_count;
+	bool has_too_many_digits;
+	int64_t exponent;
+};
+
+// Returns the index of the first character after the digits
+static size_t parse_digits(const char *text, size_t i, size_t length, struct decimal *decimal, bool is_fraction) {
+	json_assert(i < length && is_digit(text[i]), JSON_INVALID_NUMBER);
+
+	for (; i < length && is_digit(text[i]); i++) {
+		int digit = text[i] - '0';
+
+		// Leading zeros aren't significant
+		if (decimal->mantissa > 0 || digit > 0) {
+			if (decimal->significant_digit_count == 19) {
+				// The number is handed to strtod() instead
+				decimal->has_too_many_digits = true;
+			} else {
+				decimal->mantissa = decimal->mantissa * 10 + digit;
+				decimal->significant_digit_count++;
+			}
+		}
+
+		if (is_fraction) {
+			decimal->exponent--;
+		}
+	}
+
+	return i;
+}
+
+// Hands strtod() the significant digits of the number without a decimal point, like "-15e-1" for -1.5,
+// since strtod() expects the decimal point of the locale, while JSON always uses a '.'
+// The digits are collected one at a time, so numbers of any length are converted correctly:
+// once there are too many, the rest are replaced by a single '1' if any of them isn't a '0',
+// which is enough to round the number the same way
+static double parse_number_slow(const char *text, size_t length, int64_t written_exponent) {
+	char number_text[1 + MAX_SIGNIFICANT_DIGITS + MAX_EXPONENT_LENGTH];
+	size_t number_length = 0;
+
+	size_t i = 0;
+	if (text[i] == '-') {
+		number_text[number_length++] = '-';
+		i++;
+	}
+
+	size_t digit_count = 0;
+	int64_t exponent = written_exponent;
+	bool is_fraction = false;
+	bool has_dropped_digits = false;
+
+	for (; i < length && text[i] != 'e' && text[i] != 'E'; i++) {
+		char c = text[i];
+
+		if (c == '.') {
+			is_fraction = true;
+		} else if (digit_count == 0 && c == '0') {
+			// Leading zeros aren't significant
+			if (is_fraction) {
+				exponent--;
+			}
+		} else if (digit_count < MAX_SIGNIFICANT_DIGITS - 1) {
+			number_text[number_length++] = c;
+			digit_count++;
+			if (is_fraction) {
+				exponent--;
+			}
+		} else {
+			has_dropped_digits |= c != '0';
+			if (!is_fraction) {
+				exponent++;
+			}
+		}
+	}
+
+	if (digit_count == 0) {
+		return text[0] == '-' ? -0.0 : 0.0;
+	}
+
+	if (has_dropped_digits) {
+		number_text[number_length++] = '1';
+		exponent--;
+	}
+
+	snprintf(number_text + number_length, MAX_EXPONENT_LENGTH + 1, "e%" PRId64, exponent);
+
+	return strtod(number_text, NULL);
+}
+
+// Follows the grammar on https://www.json.org
+// Numbers with at most 19 significant digits that fit in a double's mantissa,
+// and that have a power of ten that is exactly representable,
+// are converted with a single multiplication or division, which is correctly rounded
+// This is Clinger's fast path, which covers most numbers in practice
+// The others are handed to strtod()
+static double parse_number(const char *text, size_t length) {
+	size_t i = 0;
+
+	bool is_negative = text[i] == '-';
+	if (is_negative) {
+		i++;
+	}
+
+	struct decimal decimal = {0};
+
+	// A leading 0 can't be followed by more digits
+	if (i < length && text[i] == '0') {
+		i++;
+	} else {
+		i = parse_digits(text, i, length, &decimal, false);
+	}
+
+	if (i < length && text[i] == '.') {
+		i = parse_digits(text, i + 1, length, &decimal, true);
+	}
+
+	int64_t written_exponent = 0;
+
+	if (i < length && (text[i] == 'e' || text[i] == 'E')) {
+		i++;
+
+		bool is_exponent_negative = false;
+		if (i < length && (text[i] == '+' || text[i] == '-')) {
+			is_exponent_negative = text[i] == '-';
+			i++;
+		}
+
+		json_assert(i < length && is_digit(text[i]), JSON_INVALID_NUMBER);
+
+		for (; i < length && is_digit(text[i]); i++) {
+			// Any bigger exponent overflows or underflows a double anyway
+			if (written_exponent < 100000) {
+				written_exponent = written_exponent * 10 + text[i] - '0';
+			}
+		}
+
+		if (is_exponent_negative) {
+			written_exponent = -written_exponent;
+		}
+		decimal.exponent += written_exponent;
+	}
+
+	json_assert(i == length, JSON_INVALID_NUMBER);
+
+	// With extended precision the division or multiplication could be rounded twice
+	if (FLT_EVAL_METHOD == 0 && !decimal.has_too_many_digits && decimal.mantissa <= (1ULL << 53) && decimal.exponent >= -22 && decimal.exponent <= 22) {
+		double number = decimal.mantissa;
+
+		if (decimal.exponent < 0) {
+			number /= powers_of_ten[-decimal.exponent];
+		} else {
+			number *= powers_of_ten[decimal.exponent];
+		}
+
+		return is_negative ? -number : number;
+	}
+
+	return parse_number_slow(text, length, written_exponent);
+}
+
+static void lex_scalar(const char *text, size_t length, struct token *token) {
+	if (text[0] == '-' || is_digit(text[0])) {
+		token->type = TOKEN_TYPE_NUMBER;
+		if (g->defers_values) {
+			token->str = (char *)text;
+		} else {
+			token->number = parse_number(text, length);
+		}
+	} else if (length == 4 && memcmp(text, "true", 4) == 0) {
+		token->type = TOKEN_TYPE_TRUE;
+	} else if (length == 5 && memcmp(text, "false", 5) == 0) {
+		token->type = TOKEN_TYPE_FALSE;
+	} else if (length == 4 && memcmp(text, "null", 4) == 0) {
+		token->type = TOKEN_TYPE_NULL;
+	} else {
+		json_error(JSON_UNRECOGNIZED_CHARACTER);
+	}
+}
+
+// Values that the projection leaves out don't have to be copied or decoded,
+// but keys always are, since they're checked for duplicates
+static bool skips_next_string(void) {
+	if (g->frames_size == 0) {
+		return false;
+	}
+
+	struct frame *frame = get_frame();
+
+	if (frame->is_object && !frame->seen_key) {
+		return false;
+	}
+
+	// The same projection that begin_value() is about to use, which count_capacities() counted the string with
+	struct projection projection = frame->is_object ? frame->value_projection : project_child(frame->projection, g->frames_size, NULL);
+
+	return is_projected_out(projection);
+}
+
+// Lexes the next token, or returns false at the end of the text
+static bool lex_token(struct token *token) {
+	size_t i = g->text_index;
+
+	if (i < g->text_size && is_whitespace(g->text[i])) {
+		i = g->skip_whitespace(g->text, i, g->text_size);
+	}
+
+	if (i >= g->text_size) {
+		g->text_index = i;
+		return false;
+	}
+
+	token->str = NULL;
+
+	if (g->text[i] == '"') {
+		size_t string_start_index = i;
+
+		bool has_escape = false;
+		bool has_control_character = false;
+		i = find_string_end(i, &has_escape, &has_control_character);
+
+		json_assert(i < g->text_size, JSON_UNCLOSED_STRING);
+		json_assert(!has_control_character, JSON_UNESCAPED_CONTROL_CHARACTER);
+
+		token->type = TOKEN_TYPE_STRING;
+		if (g->defers_values) {
+			token->str = (char *)g->text + string_start_index;
+		} else if (skips_next_string()) {
+			check_skipped_string(string_start_index + 1, i - string_start_index - 1, has_escape);
+			token->str = (char *)g->text + string_start_index;
+		} else {
+			token->str = get_string(string_start_index + 1, i - string_start_index - 1, has_escape);
+		}
+	} else if (g->text[i] == '[') {
+		token->type = TOKEN_TYPE_ARRAY_OPEN;
+	} else if (g->text[i] == ']') {
+		token->type = TOKEN_TYPE_ARRAY_CLOSE;
+	} else if (g->text[i] == '{') {
+		token->type = TOKEN_TYPE_OBJECT_OPEN;
+	} else if (g->text[i] == '}') {
+		token->type = TOKEN_TYPE_OBJECT_CLOSE;
+	} else if (g->text[i] == ',') {
+		token->type = TOKEN_TYPE_COMMA;
+	} else if (g->text[i] == ':') {
+		token->type = TOKEN_TYPE_COLON;
+	} else if (is_scalar_character(g->text[i])) {
+		size_t scalar_start_index = i;
+
+		i = find_scalar_end(g->text, i, g->text_size);
+
+		lex_scalar(g->text + scalar_start_index, i - scalar_start_index, token);
+
+		// Points at the last character of the scalar, like with the other tokens
+		i--;
+	} else {
+		json_error(JSON_UNRECOGNIZED_CHARACTER);
+	}
+
+	g->text_index = i + 1;
+
+	return true;
+}
+
+#ifdef JSON_TWO_PASS
+
+// Tokenizes the whole text up front, and lets the parser walk the tokens array
+// This is the original pipeline, which is kept around to compare against
+
+static void tokenize(void) {
+	g->text_index = 0;
+
+	while (lex_token(g->tokens + g->tokens_size)) {
+		g->tokens_size++;
+	}
+}
+
+static struct token *peek_token(void) {
+	if (g->token_index < g->tokens_size) {
+		return g->tokens + g->token_index;
+	}
+	return NULL;
+}
+
+static void next_token(void) {
+	g->token_index++;
+}
+
+static void start_tokens(void) {
+	tokenize();
+	g->token_index = 0;
+}
+
+#else
+
+// Lexes every token right before the parser needs it,
+// so no tokens array is needed
+
+static struct token *peek_token(void) {
+	if (g->has_token) {
+		return &g->token;
+	}
+	return NULL;
+}
+
+static void next_token(void) {
+	g->has_token = lex_token(&g->token);
+}
+
+static void start_tokens(void) {
+	g->text_index = 0;
+	next_token();
+}
+
+#endif
+
+// Which paths the next value in the container can lead to, like begin_value() works out,
+// where the values deeper than the containers that are kept track of use the deep projection
+static struct projection get_counted_value_projection(struct counted_container *containers, size_t depth, struct projection deep_projection) {
+	if (depth == 0) {
+		return g->root_projection;
+	}
+	if (depth > MAX_COUNTED_OBJECT_DEPTH) {
+		return deep_projection;
+	}
+
+	struct counted_container *container = containers + depth - 1;
+
+	return container->is_object ? container->value_projection : project_child(container->projection, depth, NULL);
+}
+
+// Counts how many elements each array needs at most for this text,
+// which lets them be allocated once with exact capacities before parsing,
+// and lets the push functions above skip checking for overflows
+// The values that the projection leaves out aren't stored, so they aren't counted either
+static void count_capacities(void) {
+	g->tokens_capacity = 0;
+	g->nodes_capacity = 0;
+	g->strings_capacity = 0;
+	g->fields_capacity = 0;
+	g->keys_capacity = 0;
+	g->frames_capacity = 0;
+	g->tape_capacity = 0;
+
+	g->object_indexes_capacity = 0;
+
+	// An index keeps every value, since it doesn't lex them anyway
+	g->root_projection = g->defers_values ? (struct projection){.is_kept = true} : get_root_projection();
+
+	size_t depth = 0;
+
+	// The containers that are open, as far as they're kept track of
+	struct counted_container containers[MAX_COUNTED_OBJECT_DEPTH];
+
+	// The values in deeper containers are assumed to be kept, unless a container around them is left out
+	struct projection deep_projection = {.is_kept = true};
+
+	size_t i = 0;
+
+	while (i < g->text_size) {
+		char c = g->text[i];
+
+		if (is_whitespace(c)) {
+			i = g->skip_whitespace(g->text, i, g->text_size);
+			continue;
+		}
+
+		struct counted_container *container = depth > 0 && depth <= MAX_COUNTED_OBJECT_DEPTH ? containers + depth - 1 : NULL;
+
+		if (c == '"') {
+			size_t string_start_index = i;
+
+			bool has_escape = false;
+			bool has_control_character = false;
+			i = find_string_end(i, &has_escape, &has_control_character);
+
+			g->tokens_capacity++;
+
+			bool is_key = container && container->is_object && !container->seen_key;
+
+			bool is_kept;
+			if (is_key) {
+				container->seen_key = true;
+
+				// A key with escape sequences could match any of the paths, so its value is assumed to be kept
+				if (has_escape) {
+					container->value_projection = (struct projection){.is_kept = true};
+				} else {
+					container->value_projection = project_key(container->projection, depth, g->text + string_start_index + 1, i - string_start_index - 1);
+				}
+
+				is_kept = !is_projected_out(container->value_projection);
+				if (is_kept) {
+					container->kept_field_count++;
+				}
+			} else {
+				is_kept = !is_projected_out(get_counted_value_projection(containers, depth, deep_projection));
+				if (is_kept) {
+					g->nodes_capacity++;
+				}
+			}
+
+			if (is_kept) {
+				g->tape_capacity++;
+			}
+
+#ifdef JSON_TWO_PASS
+			// All tokens are lexed before the projection is known
+			is_kept = true;
+#endif
+
+			// The string's characters plus its '\0', which is too much if it has escape sequences
+			// Keys are always copied, since they're checked for duplicates,
+			// and every string deeper than the containers that are kept track of could be one
+			bool may_be_key = is_key || depth > MAX_COUNTED_OBJECT_DEPTH;
+			if (g->copies_strings && (may_be_key || is_kept)) {
+				g->strings_capacity += i - string_start_index;
+			}
+		} else if (c == '[' || c == '{') {
+			g->tokens_capacity++;
+
+			struct projection projection = get_counted_value_projection(containers, depth, deep_projection);
+
+			// Every bracket of a kept container gets a word on the tape
+			if (!is_projected_out(projection)) {
+				g->nodes_capacity++;
+				g->tape_capacity++;
+			}
+
+			if (depth < MAX_COUNTED_OBJECT_DEPTH) {
+				containers[depth] = (struct counted_container){
+					.is_object = c == '{',
+					.projection = projection,
+				};
+			} else if (depth == MAX_COUNTED_OBJECT_DEPTH) {
+				deep_projection = is_projected_out(projection) ? projection : (struct projection){.is_kept = true};
+			}
+
+			depth++;
+			if (depth > g->frames_capacity) {
+				g->frames_capacity = depth;
+			}
+		} else if (c == ']' || c == '}') {
+			g->tokens_capacity++;
+
+			if (container) {
+				if (!is_projected_out(container->projection)) {
+					g->tape_capacity++;
+
+					g->fields_capacity += container->kept_field_count;
+
+					// Small objects are searched directly, so they don't get an index
+					if (container->kept_field_count > MAX_DIRECTLY_COMPARED_FIELDS) {
+						g->object_indexes_capacity += get_object_index_size(container->kept_field_count);
+					}
+				}
+			} else if (depth > 0) {
+				g->tape_capacity++;
+			}
+
+			if (depth > 0) {
+				depth--;
+			}
+		} else if (c == ',') {
+			g->tokens_capacity++;
+
+			if (container) {
+				container->seen_key = false;
+			}
+		} else if (c == ':') {
+			g->tokens_capacity++;
+			g->keys_capacity++;
+
+			// The fields of deeper objects aren't counted, so each of them reserves room
+			// for a header, fewer than 3 slots, and the rounding, which is always enough
+			if (depth > MAX_COUNTED_OBJECT_DEPTH) {
+				g->fields_capacity++;
+				g->object_indexes_capacity += sizeof(struct json_object_index) + 3 * sizeof(uint32_t) + sizeof(struct json_field);
+			}
+		} else if (is_scalar_character(c)) {
+			g->tokens_capacity++;
+
+			// A number takes two words on the tape
+			if (!is_projected_out(get_counted_value_projection(containers, depth, deep_projection))) {
+				g->nodes_capacity++;
+				g->tape_capacity += c == '-' || is_digit(c) ? 2 : 1;
+			}
+
+			i = find_scalar_end(g->text, i, g->text_size);
+			continue;
+		}
+		i++;
+	}
+
+#ifndef JSON_TWO_PASS
+	// Tokens are lexed right before they're parsed, so they aren't stored
+	g->tokens_capacity = 0;
+#endif
+
+	if (!g->builds_tree) {
+		g->nodes_capacity = 0;
+		g->object_indexes_capacity = 0;
+	}
+
+	if (!g->builds_tape) {
+		g->tape_capacity = 0;
+	}
+}
+
+static void check_if_out_of_memory(size_t size, size_t capacity) {
+	g->required_size = size;
+	if (size > capacity) {
+		json_error(JSON_OUT_OF_MEMORY);
+	}
+}
+
+// Used to align to 16 bytes
+static size_t get_padding(size_t n) {
+	return (16 - (n % 16)) % 16;
+}
+
+// The size is counted from the start of the buffer, which is padding bytes before g
+static void *get_next_aligned_area(size_t *size) {
+	*size += get_padding(*size - g->padding);
+	return (char *)g + *size - g->padding;
+}
+
+// Points g at the first 16-byte aligned address in the buffer, and returns its padding
+static size_t use_buffer(void *buffer) {
+	size_t padding = get_padding((size_t)buffer);
+	g = (void *)(padding + (char *)buffer);
+	g->padding = padding;
+	return padding;
+}
+
+// Reserves space for the g struct itself in the buffer
+static size_t allocate_g(size_t capacity, size_t padding) {
+	size_t size = padding + sizeof(*g);
+	check_if_out_of_memory(size, capacity);
+	return size;
+}
+
+static size_t read_text(char *json_file_path, size_t size, size_t capacity) {
+	FILE *f = fopen(json_file_path, "r");
+	json_assert(f, JSON_FAILED_TO_OPEN_FILE);
+
+	// Size the text region from the file size, so a regular file is read exactly once
+	// The + 1 lets fread() hit the end of the file
+	struct stat st;
+	if (fstat(fileno(f), &st) == 0 && S_ISREG(st.st_mode)) {
+		g->text_capacity = st.st_size + 1;
+	}
+
+	g->text = get_next_aligned_area(&size);
+	size += g->text_capacity * sizeof(*g->text);
+	if (size > capacity) {
+		json_assert(fclose(f) == 0, JSON_FAILED_TO_CLOSE_FILE);
+		check_if_out_of_memory(size, capacity);
+	}
+
+	g->text_size = fread(
+		(char *)g->text,
+		sizeof(char),
+		g->text_capacity,
+		f
+	);
+
+	int is_eof = feof(f);
+	int err = ferror(f);
+
+	json_assert(fclose(f) == 0, JSON_FAILED_TO_CLOSE_FILE);
+
+	json_assert(g->text_size != 0, JSON_FILE_EMPTY);
+
+	if (!is_eof) {
+		g->text_capacity *= 2;
+		json_error(JSON_RESTART);
+	}
+
+	json_assert(err == 0, JSON_FILE_READING_ERROR);
+
+	return size;
+}
+
+static void allocate_arrays(size_t size, size_t capacity) {
+	g->tokens_size = 0;
+	g->nodes_size = 0;
+	g->strings_size = 0;
+	g->fields_size = 0;
+	g->tape_size = 0;
+
+	g->tokens = get_next_aligned_area(&size);
+	size += g->tokens_capacity * sizeof(*g->tokens);
+
+	g->nodes = get_next_aligned_area(&size);
+	size += g->nodes_capacity * sizeof(*g->nodes);
+
+	g->strings = get_next_aligned_area(&size);
+	size += g->strings_capacity * sizeof(*g->strings);
+
+	// Without a tree the fields are only needed for the duplicate key check,
+	// which just uses the buckets and chains below
+	// The indexes of the objects with lots of fields are put in front of their fields
+	g->fields = get_next_aligned_area(&size);
+	if (g->builds_tree) {
+		size += g->fields_capacity * sizeof(*g->fields) + g->object_indexes_capacity;
+	}
+
+	// Deferred keys aren't checked for duplicates
+	g->fields_buckets = get_next_aligned_area(&size);
+	g->fields_buckets_capacity = g->defers_values ? 0 : get_bucket_count(g->keys_capacity);
+	size += g->fields_buckets_capacity * sizeof(*g->fields_buckets);
+
+	g->fields_chains = get_next_aligned_area(&size);
+	if (!g->defers_values) {
+		size += g->keys_capacity * sizeof(*g->fields_chains);
+	}
+
+	g->tape = get_next_aligned_area(&size);
+	size += g->tape_capacity * sizeof(*g->tape);
+
+	// The frames are pushed down from the end of their array, like in json_feed()
+	g->frames_end = (struct frame *)get_next_aligned_area(&size) + g->frames_capacity;
+	size += g->frames_capacity * sizeof(*g->frames_end);
+
+	// Every value and field can be waiting on these stacks at the same time in the worst case
+	// Without a tree an array's children aren't stored
+	g->child_nodes = get_next_aligned_area(&size);
+	size += g->nodes_capacity * sizeof(*g->child_nodes);
+
+	g->child_fields = get_next_aligned_area(&size);
+	size += g->keys_capacity * sizeof(*g->child_fields);
+
+	// Only checked once all arrays are laid out, so the required size is exact
+	check_if_out_of_memory(size, capacity);
+
+	// The buckets are only cleared once per parse, since every object stamps them with a new generation
+	memset(g->fields_buckets, 0, g->fields_buckets_capacity * sizeof(*g->fields_buckets));
+	g->fields_generation = 0;
+}
+
+static void get_tape(struct json_tape *tape) {
+	tape->words = g->tape;
+	tape->word_count = g->tape_size;
+	tape->strings = g->tape_strings;
+}
+
+static void get_root_cursor(struct json_cursor *cursor, void *buffer) {
+	cursor->buffer = buffer;
+	cursor->index = 0;
+	cursor->end = g->tape_size;
+	cursor->in_object = false;
+}
+
+static void parse_text(struct json_node *returned) {
+	// Reset before the first token is lexed, since the lexer looks at the frames
+	g->frames_size = 0;
+	g->child_nodes_size = 0;
+	g->child_fields_size = 0;
+	g->seen_root = false;
+
+	g->skips_value = false;
+
+	start_tokens();
+
+	// Memory mode copies its strings, and file mode terminates them in the text
+	g->tape_strings = g->copies_strings ? g->strings : (char *)g->text;
+
+	struct token *token;
+	while ((token = peek_token())) {
+		parse_token(token);
+		next_token();
+	}
+
+	finish_parsing();
+
+	*returned = g->root;
+}
+
+static enum json_status parse_file(char *json_file_path, struct json_node *returned, struct json_tape *tape, struct json_cursor *cursor, void *buffer, size_t buffer_capacity) {
+	size_t padding = use_buffer(buffer);
+
+	enum json_status status = setjmp(g->error_jmp_buffer);
+	if (status && status != JSON_RESTART) {
+		return status;
+	}
+
+	g->callbacks = &no_callbacks;
+	g->builds_tree = !tape && !cursor;
+	g->builds_tape = tape || cursor;
+	g->defers_values = cursor != NULL;
+	g->feeds_chunks = false;
+
+	size_t size = allocate_g(buffer_capacity, padding);
+
+	size = read_text(json_file_path, size, buffer_capacity);
+
+	g->copies_strings = false;
+
+	count_capacities();
+
+	allocate_arrays(size, buffer_capacity);
+
+	parse_text(returned);
+
+	if (tape) {
+		get_tape(tape);
+	}
+
+	if (cursor) {
+		get_root_cursor(cursor, buffer);
+	}
+
+	return JSON_OK;
+}
+
+static enum json_status parse_memory(const char *data, size_t data_size, struct json_node *returned, struct json_tape *tape, struct json_cursor *cursor, void *buffer, size_t buffer_capacity) {
+	size_t padding = use_buffer(buffer);
+
+	enum json_status status = setjmp(g->error_jmp_buffer);
+	if (status && status != JSON_RESTART) {
+		return status;
+	}
+
+	g->callbacks = &no_callbacks;
+	g->builds_tree = !tape && !cursor;
+	g->builds_tape = tape || cursor;
+	g->defers_values = cursor != NULL;
+	g->feeds_chunks = false;
+
+	size_t size = allocate_g(buffer_capacity, padding);
+
+	// The text is tokenized straight from the caller's memory, so it doesn't need a copy
+	g->text = data;
+	g->text_size = data_size;
+
+	g->copies_strings = true;
+
+	count_capacities();
+
+	allocate_arrays(size, buffer_capacity);
+
+	parse_text(returned);
+
+	if (tape) {
+		get_tape(tape);
+	}
+
+	if (cursor) {
+		get_root_cursor(cursor, buffer);
+	}
+
+	return JSON_OK;
+}
+
+enum json_status json(char *json_file_path, struct json_node *returned, void *buffer, size_t buffer_capacity) {
+	return parse_file(json_file_path, returned, NULL, NULL, buffer, buffer_capacity);
+}
+
+enum json_status json_parse_memory(const char *data, size_t data_size, struct json_node *returned, void *buffer, size_t buffer_capacity) {
+	return parse_memory(data, data_size, returned, NULL, NULL, buffer, buffer_capacity);
+}
+
+enum json_status json_parse_tape(char *json_file_path, struct json_tape *returned, void *buffer, size_t buffer_capacity) {
+	struct json_node node;
+	return parse_file(json_file_path, &node, returned, NULL, buffer, buffer_capacity);
+}
+
+enum json_status json_parse_tape_memory(const char *data, size_t data_size, struct json_tape *returned, void *buffer, size_t buffer_capacity) {
+	struct json_node node;
+	return parse_memory(data, data_size, &node, returned, NULL, buffer, buffer_capacity);
+}
+
+enum json_status json_index(char *json_file_path, struct json_cursor *root, void *buffer, size_t buffer_capacity) {
+	struct json_node node;
+	return parse_file(json_file_path, &node, NULL, root, buffer, buffer_capacity);
+}
+
+// The data has to stay around for as long as the cursors are used, since the strings and numbers are lexed from it
+enum json_status json_index_memory(const char *data, size_t data_size, struct json_cursor *root, void *buffer, size_t buffer_capacity) {
+	struct json_node node;
+	return parse_memory(data, data_size, &node, NULL, root, buffer, buffer_capacity);
+}
+
+// The json_feed() parser gets its text in chunks, and hands it to parse_token() one token at a time
+// Its buffer holds two stacks that grow towards each other:
+// the bytes of the keys of the open objects followed by the string that is being lexed,
+// and the frames of the open arrays and objects, which grow down from the end of the buffer
+
+// The required size is the most the stacks have needed so far,
+// so it's enough to feed the same text again once it's done
+static void check_feed_space(size_t byte_count) {
+	size_t used = g->feed_bytes_size + g->frames_size * sizeof(*g->frames_end);
+	size_t needed = used + byte_count;
+	size_t required_size = g->feed_bytes_offset + needed + (_Alignof(struct frame) - needed % _Alignof(struct frame)) % _Alignof(struct frame);
+
+	if (required_size > g->required_size) {
+		g->required_size = required_size;
+	}
+
+	json_assert(used + byte_count <= g->feed_capacity, JSON_OUT_OF_MEMORY);
+}
+
+static void push_feed_bytes(const char *bytes, size_t length) {
+	check_feed_space(length);
+	memcpy(g->feed_bytes + g->feed_bytes_size, bytes, length);
+	g->feed_bytes_size += length;
+}
+
+// Checks the keys of the object that is being closed, which are the last bytes on the stack
+// The keys of the values that the projection left out are there too, so they're counted by their '\0's
+static void check_feed_duplicate_keys(struct frame *frame) {
+	size_t fields_offset = g->feed_bytes_size + get_padding(g->feed_bytes_size);
+
+	size_t field_count = 0;
+	for (size_t i = frame->children_start; i < g->feed_bytes_size; i++) {
+		field_count += g->feed_bytes[i] == '\0';
+	}
+	size_t bucket_count = field_count > MAX_DIRECTLY_COMPARED_FIELDS ? get_bucket_count(field_count) : 0;
+
+	check_feed_space(fields_offset - g->feed_bytes_size + field_count * (sizeof(struct json_field) + sizeof(uint32_t)) + bucket_count * sizeof(struct bucket));
+
+	struct json_field *child_fields = (void *)(g->feed_bytes + fields_offset);
+	g->fields_buckets = (struct bucket *)(child_fields + field_count);
+	g->fields_chains = (uint32_t *)(g->fields_buckets + bucket_count);
+
+	// These buckets are in the middle of the byte stack, so they have to be cleared every time
+	g->fields_buckets_capacity = bucket_count;
+	memset(g->fields_buckets, 0, bucket_count * sizeof(*g->fields_buckets));
+
+	char *key = g->feed_bytes + frame->children_start;
+	for (size_t i = 0; i < field_count; i++) {
+		child_fields[i].key = key;
+		key += strlen(key) + 1;
+	}
+
+	check_duplicate_keys(child_fields, field_count);
+}
+
+// The whole scalar is needed before it can be lexed, so its characters are collected on the byte stack
+static void end_feed_scalar(void) {
+	struct token token;
+	lex_scalar(g->feed_bytes + g->feed_scalar_start, g->feed_bytes_size - g->feed_scalar_start, &token);
+
+	g->feed_bytes_size = g->feed_scalar_start;
+	g->feed_in_scalar = false;
+
+	parse_token(&token);
+}
+
+static void feed_text(const char *chunk, size_t chunk_size) {
+	size_t i = 0;
+
+	while (i < chunk_size) {
+		// A string can be split over any number of chunks, even in the middle of an escape sequence
+		if (g->feed_in_string) {
+			// The character after a '\\' can't end the string, even when it's a '"'
+			if (g->feed_in_escape) {
+				push_feed_bytes(chunk + i, 1);
+				g->feed_in_escape = false;
+				i++;
+				continue;
+			}
+
+			size_t string_end = g->find_escaped_character(chunk, i, chunk_size);
+
+			push_feed_bytes(chunk + i, string_end - i);
+
+			if (string_end == chunk_size) {
+				return;
+			}
+
+			// Also keeps NUL bytes out of keys, which are compared as C strings
+			json_assert(chunk[string_end] == '"' || chunk[string_end] == '\\', JSON_UNESCAPED_CONTROL_CHARACTER);
+
+			if (chunk[string_end] == '\\') {
+				push_feed_bytes("\\", 1);
+				g->feed_in_escape = true;
+				g->feed_string_has_escape = true;
+				i = string_end + 1;
+				continue;
+			}
+
+			g->feed_in_string = false;
+
+			if (g->validates_utf8) {
+				json_assert(g->is_valid_utf8(g->feed_bytes + g->feed_string_start, g->feed_bytes_size - g->feed_string_start), JSON_INVALID_UTF8);
+			}
+
+			// The escape sequences are only decoded once the whole string is on the stack
+			if (g->feed_string_has_escape) {
+				g->feed_bytes_size = g->feed_string_start + unescape_string(g->feed_bytes + g->feed_string_start, g->feed_bytes_size - g->feed_string_start);
+			}
+
+			push_feed_bytes("", 1);
+
+			parse_token(&(struct token){.type = TOKEN_TYPE_STRING, .str = g->feed_bytes + g->feed_string_start});
+
+			i = string_end + 1;
+			continue;
+		}
+
+		// So can a scalar
+		if (g->feed_in_scalar) {
+			size_t scalar_end = find_scalar_end(chunk, i, chunk_size);
+
+			push_feed_bytes(chunk + i, scalar_end - i);
+
+			if (scalar_end == chunk_size) {
+				return;
+			}
+
+			end_feed_scalar();
+
+			i = scalar_end;
+			continue;
+		}
+
+		char c = chunk[i];
+
+		if (is_whitespace(c)) {
+			i = g->skip_whitespace(chunk, i, chunk_size);
+			continue;
+		}
+
+		if (c == '"') {
+			g->feed_in_string = true;
+			g->feed_in_escape = false;
+			g->feed_string_has_escape = false;
+			g->feed_string_start = g->feed_bytes_size;
+		} else if (c == '[') {
+			parse_token(&(struct token){.type = TOKEN_TYPE_ARRAY_OPEN});
+		} else if (c == ']') {
+			parse_token(&(struct token){.type = TOKEN_TYPE_ARRAY_CLOSE});
+		} else if (c == '{') {
+			parse_token(&(struct token){.type = TOKEN_TYPE_OBJECT_OPEN});
+		} else if (c == '}') {
+			parse_token(&(struct token){.type = TOKEN_TYPE_OBJECT_CLOSE});
+		} else if (c == ',') {
+			parse_token(&(struct token){.type = TOKEN_TYPE_COMMA});
+		} else if (c == ':') {
+			parse_token(&(struct token){.type = TOKEN_TYPE_COLON});
+		} else if (is_scalar_character(c)) {
+			g->feed_in_scalar = true;
+			g->feed_scalar_start = g->feed_bytes_size;
+			continue;
+		} else {
+			json_error(JSON_UNRECOGNIZED_CHARACTER);
+		}
+		i++;
+	}
+}
+
+enum json_status json_feed_start(struct json_callbacks *callbacks, void *buffer, size_t buffer_capacity) {
+	size_t padding = use_buffer(buffer);
+
+	enum json_status status = setjmp(g->error_jmp_buffer);
+	if (status) {
+		g->feed_status = status;
+		return status;
+	}
+
+	g->callbacks = callbacks ? callbacks : &no_callbacks;
+	g->builds_tree = false;
+	g->builds_tape = false;
+	g->defers_values = false;
+	g->feeds_chunks = true;
+
+	size_t size = allocate_g(buffer_capacity, padding);
+
+	g->feed_bytes = get_next_aligned_area(&size);
+	g->feed_bytes_size = 0;
+
+	// The frames are put at the end of the buffer, and grow down towards the bytes
+	// The bytes start aligned, so rounding the space down keeps the frames aligned,
+	// without the required size depending on where the buffer ends
+	g->feed_capacity = size < buffer_capacity ? (buffer_capacity - size) / _Alignof(struct frame) * _Alignof(struct frame) : 0;
+	g->frames_end = (void *)(g->feed_bytes + g->feed_capacity);
+	g->frames_size = 0;
+
+	g->feed_bytes_offset = size;
+
+	g->feed_in_string = false;
+	g->feed_in_scalar = false;
+	g->seen_root = false;
+
+	g->root_projection = get_root_projection();
+	g->skips_value = false;
+	g->fields_generation = 0;
+
+	g->feed_status = JSON_OK;
+
+	return JSON_OK;
+}
+
+enum json_status json_feed(const char *chunk, size_t chunk_size, void *buffer) {
+	use_buffer(buffer);
+
+	// Once the text turned out to be invalid, feeding more of it can't fix that
+	if (g->feed_status) {
+		return g->feed_status;
+	}
+
+	enum json_status status = setjmp(g->error_jmp_buffer);
+	if (status) {
+		g->feed_status = status;
+		return status;
+	}
+
+	feed_text(chunk, chunk_size);
+
+	return JSON_OK;
+}
+
+enum json_status json_finish(void *buffer) {
+	use_buffer(buffer);
+
+	if (g->feed_status) {
+		return g->feed_status;
+	}
+
+	enum json_status status = setjmp(g->error_jmp_buffer);
+	if (status) {
+		g->feed_status = status;
+		return status;
+	}
+
+	json_assert(!g->feed_in_string, JSON_UNCLOSED_STRING);
+
+	if (g->feed_in_scalar) {
+		end_feed_scalar();
+	}
+
+	finish_parsing();
+
+	// The stream is done, so feeding more text is an error
+	g->feed_status = JSON_UNEXPECTED_EXTRA_CHARACTER;
+
+	return JSON_OK;
+}
+
+static void feed_file(char *json_file_path) {
+	g->sax_file = fopen(json_file_path, "r");
+	json_assert(g->sax_file, JSON_FAILED_TO_OPEN_FILE);
+
+	char chunk[SAX_CHUNK_SIZE];
+	bool is_empty = true;
+
+	size_t chunk_size;
+	while ((chunk_size = fread(chunk, sizeof(char), sizeof(chunk), g->sax_file)) > 0) {
+		is_empty = false;
+		feed_text(chunk, chunk_size);
+	}
+
+	int err = ferror(g->sax_file);
+
+	FILE *f = g->sax_file;
+	g->sax_file = NULL;
+	json_assert(fclose(f) == 0, JSON_FAILED_TO_CLOSE_FILE);
+
+	json_assert(!is_empty, JSON_FILE_EMPTY);
+
+	json_assert(err == 0, JSON_FILE_READING_ERROR);
+}
+
+// Works just like json_feed(), so the buffer only has to hold the keys of the open objects,
+// the string that is being lexed, and the frames, no matter how big the file is
+enum json_status json_sax(char *json_file_path, struct json_callbacks *callbacks, void *buffer, size_t buffer_capacity) {
+	enum json_status status = json_feed_start(callbacks, buffer, buffer_capacity);
+	if (status) {
+		return status;
+	}
+
+	g->sax_file = NULL;
+
+	status = setjmp(g->error_jmp_buffer);
+	if (status) {
+		if (g->sax_file) {
+			fclose(g->sax_file);
+		}
+		return status;
+	}
+
+	feed_file(json_file_path);
+
+	return json_finish(buffer);
+}
+
+enum json_status json_sax_memory(const char *data, size_t data_size, struct json_callbacks *callbacks, void *buffer, size_t buffer_capacity) {
+	enum json_status status = json_feed_start(callbacks, buffer, buffer_capacity);
+	if (status) {
+		return status;
+	}
+
+	status = json_feed(data, data_size, buffer);
+	if (status) {
+		return status;
+	}
+
+	return json_finish(buffer);
+}
+
+struct batch {
+	struct json_batch_document *documents;
+	size_t document_count;
+	atomic_size_t next_document_index;
+};
+
+// Every worker keeps claiming the next unparsed document,
+// so a worker that gets small files just ends up parsing more of them
+static void *parse_batch_documents(void *batch_pointer) {
+	struct batch *batch = batch_pointer;
+
+	size_t i;
+	while ((i = atomic_fetch_add(&batch->next_document_index, 1)) < batch->document_count) {
+		struct json_batch_document *document = batch->documents + i;
+
+		document->status = json(document->json_file_path, &document->node, document->buffer, document->buffer_capacity);
+	}
+
+	return NULL;
+}
+
+void json_parse_batch(struct json_batch_document *documents, size_t document_count, size_t thread_count) {
+	struct batch batch = {
+		.documents = documents,
+		.document_count = document_count,
+	};
+	atomic_init(&batch.next_document_index, 0);
+
+	if (thread_count == 0) {
+		long processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+		thread_count = processor_count > 0 ? processor_count : 1;
+	}
+	if (thread_count > document_count) {
+		thread_count = document_count;
+	}
+	if (thread_count > MAX_BATCH_THREADS) {
+		thread_count = MAX_BATCH_THREADS;
+	}
+
+	pthread_t threads[MAX_BATCH_THREADS];
+	size_t started_thread_count = 0;
+
+	// The calling thread is a worker too
+	// If a thread can't be started, the workers that did start just parse its share
+	while (started_thread_count + 1 < thread_count) {
+		if (pthread_create(threads + started_thread_count, NULL, parse_batch_documents, &batch) != 0) {
+			break;
+		}
+		started_thread_count++;
+	}
+
+	parse_batch_documents(&batch);
+
+	for (size_t i = 0; i < started_thread_count; i++) {
+		pthread_join(threads[i], NULL);
+	}
+}
+
+bool json_init(void *buffer, size_t buffer_capacity) {
+	size_t padding = get_padding((size_t)buffer);
+
+	if (buffer_capacity < padding + sizeof(*g)) {
+		return true;
+	}
+
+	use_buffer(buffer);
+
+	g->error_line_number = 0;
+	g->required_size = 0;
 
 	g->text_capacity = 1;
-	g->tokens_capacity = 1;
-	g->nodes_capacity = 1;
-	g->strings_capacity = 1;
-	g->fields_capacity = 1;
 
-	g->initialized = true;
+	// Without a secret seed the keys could be crafted to all collide,
+	// so the weaker fallback is only for systems that don't have getentropy()
+	if (getentropy(g->hash_seed, sizeof(g->hash_seed)) != 0) {
+		g->hash_seed[0] = (uintptr_t)buffer;
+		g->hash_seed[1] = time(NULL);
+	}
+
+	select_scanners();
+
+	g->validates_utf8 = false;
+	g->projection_path_count = 0;
+
+	g->initialized = true;
+
+	return false;
+}
+
+struct json_node *json_object_get(struct json_object *object, const char *key) {
+	struct json_object_index *index = get_object_index(object);
+
+	if (!index) {
+		for (size_t i = 0; i < object->field_count; i++) {
+			if (strcmp(key, object->fields[i].key) == 0) {
+				return object->fields[i].value;
+			}
+		}
+		return NULL;
+	}
+
+	size_t bucket_index = hash_key(key, index->hash_seed) & index->bucket_mask;
+	uint32_t *chains = index->slots + index->bucket_mask + 1;
+
+	for (uint32_t i = index->slots[bucket_index]; i != UINT32_MAX; i = chains[i]) {
+		if (strcmp(key, object->fields[i].key) == 0) {
+			return object->fields[i].value;
+		}
+	}
+
+	return NULL;
+}
+
+// Array indexes can't have leading zeros
+static size_t parse_pointer_index(const char *key, size_t key_length) {
+	if (key_length == 0 || key_length > MAX_POINTER_INDEX_DIGITS || (key[0] == '0' && key_length > 1)) {
+		return SIZE_MAX;
+	}
+
+	size_t index = 0;
+	for (size_t i = 0; i < key_length; i++) {
+		if (!is_digit(key[i])) {
+			return SIZE_MAX;
+		}
+		index = index * 10 + key[i] - '0';
+	}
+	return index;
+}
+
+// The pointer is split in place, like the strings in the text,
+// so it has to stay around for as long as the compiled pointer is used
+// The keys are hashed with the seed of the buffer, so they don't have to be hashed again
+// when they're looked up in the objects with lots of fields that were parsed with that buffer
+enum json_status json_compile_pointer(char *pointer, struct json_pointer *compiled, void *buffer) {
+	use_buffer(buffer);
+
+	// The empty pointer is the root
+	if (*pointer != '\0' && *pointer != '/') {
+		return JSON_INVALID_POINTER;
+	}
+
+	size_t token_count = 0;
+	for (char *c = pointer; *c != '\0'; c++) {
+		if (*c == '/') {
+			token_count++;
+		} else if (*c == '~' && c[1] != '0' && c[1] != '1') {
+			return JSON_INVALID_POINTER;
+		}
+	}
+	if (token_count > compiled->token_capacity) {
+		return JSON_OUT_OF_MEMORY;
+	}
+
+	compiled->token_count = 0;
+	memcpy(compiled->hash_seed, g->hash_seed, sizeof(compiled->hash_seed));
+
+	char *read = pointer;
+	bool has_token = *read == '/';
+	while (has_token) {
+		// Skips the '/'
+		read++;
+
+		// "~1" is decoded to '/', and "~0" to '~', so the key never grows
+		char *key = read;
+		char *written = read;
+		while (*read != '\0' && *read != '/') {
+			if (*read == '~') {
+				*written++ = read[1] == '1' ? '/' : '~';
+				read += 2;
+			} else {
+				*written++ = *read++;
+			}
+		}
+
+		// The terminator may overwrite the '/' of the next token, so it has to be seen first
+		has_token = *read == '/';
+		*written = '\0';
+
+		size_t key_length = written - key;
+
+		compiled->tokens[compiled->token_count++] = (struct json_pointer_token){
+			.key = key,
+			.key_length = key_length,
+			.key_hash = hash_key(key, g->hash_seed),
+			.index = parse_pointer_index(key, key_length),
+		};
+	}
+
+	return JSON_OK;
+}
+
+// Returns NULL if the node doesn't have the child
+static struct json_node *get_pointer_child(struct json_node *node, struct json_pointer_token *token, uint64_t *hash_seed) {
+	if (node->type == JSON_NODE_ARRAY) {
+		return token->index < node->array.value_count ? node->array.values + token->index : NULL;
+	}
+	if (node->type != JSON_NODE_OBJECT) {
+		return NULL;
+	}
+
+	struct json_object *object = &node->object;
+
+	struct json_object_index *index = get_object_index(object);
+
+	if (!index) {
+		return json_object_get(object, token->key);
+	}
+
+	// The object was parsed with another buffer than the pointer was compiled for
+	uint64_t hash = token->key_hash;
+	if (memcmp(index->hash_seed, hash_seed, sizeof(index->hash_seed)) != 0) {
+		hash = hash_key(token->key, index->hash_seed);
+	}
+
+	size_t bucket_index = hash & index->bucket_mask;
+	uint32_t *chains = index->slots + index->bucket_mask + 1;
+
+	for (uint32_t i = index->slots[bucket_index]; i != UINT32_MAX; i = chains[i]) {
+		if (strcmp(token->key, object->fields[i].key) == 0) {
+			return object->fields[i].value;
+		}
+	}
+
+	return NULL;
+}
+
+// Returns NULL if the tree doesn't have the value the pointer points to
+struct json_node *json_pointer_get(struct json_node *root, struct json_pointer *pointer) {
+	struct json_node *node = root;
+
+	for (size_t i = 0; node && i < pointer->token_count; i++) {
+		node = get_pointer_child(node, pointer->tokens + i, pointer->hash_seed);
+	}
+
+	return node;
+}
+
+static bool is_same_pointer_token(struct json_pointer_token *a, struct json_pointer_token *b) {
+	return a->key_length == b->key_length && memcmp(a->key, b->key, a->key_length) == 0;
+}
+
+// Every pointer continues from the deepest node that it shares with the pointer before it,
+// so pointers with the same start should be next to each other, like when they're sorted
+void json_pointer_get_batch(struct json_node *root, struct json_pointer *pointers, size_t pointer_count, struct json_node **results) {
+	// The nodes that the previous pointer went through, starting with the root
+	struct json_node *path[MAX_SHARED_POINTER_TOKENS + 1];
+	path[0] = root;
+	size_t path_size = 1;
+
+	for (size_t pointer_index = 0; pointer_index < pointer_count; pointer_index++) {
+		struct json_pointer *pointer = pointers + pointer_index;
+
+		size_t shared_count = 0;
+		if (pointer_index > 0) {
+			struct json_pointer *previous = pointer - 1;
+			while (shared_count + 1 < path_size && shared_count < pointer->token_count && is_same_pointer_token(previous->tokens + shared_count, pointer->tokens + shared_count)) {
+				shared_count++;
+			}
+		}
+
+		struct json_node *node = path[shared_count];
+		path_size = shared_count + 1;
+
+		for (size_t i = shared_count; node && i < pointer->token_count; i++) {
+			node = get_pointer_child(node, pointer->tokens + i, pointer->hash_seed);
+
+			if (node && path_size == i + 1 && path_size <= MAX_SHARED_POINTER_TOKENS) {
+				path[path_size++] = node;
+			}
+		}
+
+		results[pointer_index] = node;
+	}
+}
+
+static char get_tape_tag(struct json_tape *tape, size_t index) {
+	return tape->words[index] >> TAPE_TAG_SHIFT;
+}
+
+static uint64_t get_tape_payload(struct json_tape *tape, size_t index) {
+	return tape->words[index] & TAPE_PAYLOAD_MASK;
+}
+
+int json_tape_get_type(struct json_tape *tape, size_t index) {
+	char tag = get_tape_tag(tape, index);
+
+	if (tag == '[') {
+		return JSON_NODE_ARRAY;
+	} else if (tag == '{') {
+		return JSON_NODE_OBJECT;
+	} else if (tag == 'd') {
+		return JSON_NODE_NUMBER;
+	} else if (tag == 't' || tag == 'f') {
+		return JSON_NODE_BOOL;
+	} else if (tag == 'n') {
+		return JSON_NODE_NULL;
+	}
+	return JSON_NODE_STRING;
+}
+
+char *json_tape_get_string(struct json_tape *tape, size_t index) {
+	return tape->strings + get_tape_payload(tape, index);
+}
+
+double json_tape_get_number(struct json_tape *tape, size_t index) {
+	double number;
+	memcpy(&number, tape->words + index + 1, sizeof(number));
+	return number;
+}
+
+bool json_tape_get_bool(struct json_tape *tape, size_t index) {
+	return get_tape_tag(tape, index) == 't';
+}
+
+size_t json_tape_get_count(struct json_tape *tape, size_t index) {
+	return get_tape_payload(tape, get_tape_payload(tape, index) - 1);
+}
+
+size_t json_tape_next(struct json_tape *tape, size_t index) {
+	char tag = get_tape_tag(tape, index);
+
+	if (tag == '[' || tag == '{') {
+		return get_tape_payload(tape, index);
+	} else if (tag == 'd') {
+		return index + 2;
+	}
+	return index + 1;
+}
+
+// The index that json_index() builds is a tape whose strings and numbers still point into the text,
+// so it also sets g to the cursor's buffer
+static struct json_tape get_cursor_tape(struct json_cursor *cursor) {
+	use_buffer(cursor->buffer);
+	return (struct json_tape){
+		.words = g->tape,
+		.word_count = g->tape_size,
+		.strings = g->tape_strings,
+	};
+}
+
+// Lexes the string at the index the first time it's reached,
+// and replaces its word with an ordinary string word, so it's lexed only once
+static char *get_deferred_string(struct json_tape *tape, size_t index) {
+	if (get_tape_tag(tape, index) == '"') {
+		return json_tape_get_string(tape, index);
+	}
 
-	return false;
+	size_t quote_index = get_tape_payload(tape, index);
+
+	// lex_token() already rejected the control characters
+	bool has_escape = false;
+	bool has_control_character = false;
+	size_t string_end = find_string_end(quote_index, &has_escape, &has_control_character);
+
+	char *str = get_string(quote_index + 1, string_end - quote_index - 1, has_escape);
+
+	tape->words[index] = (uint64_t)'"' << TAPE_TAG_SHIFT | (str - tape->strings);
+
+	return str;
+}
+
+// Keys without escape sequences are compared straight against the text, so they never have to be lexed
+static bool is_deferred_key(struct json_tape *tape, size_t index, const char *key, size_t key_length) {
+	if (get_tape_tag(tape, index) == 's' && !g->validates_utf8) {
+		size_t quote_index = get_tape_payload(tape, index);
+
+		bool has_escape = false;
+		bool has_control_character = false;
+		size_t string_end = find_string_end(quote_index, &has_escape, &has_control_character);
+
+		if (!has_escape) {
+			return string_end - quote_index - 1 == key_length && memcmp(g->text + quote_index + 1, key, key_length) == 0;
+		}
+	}
+
+	return strcmp(get_deferred_string(tape, index), key) == 0;
+}
+
+int json_cursor_get_type(struct json_cursor *cursor) {
+	struct json_tape tape = get_cursor_tape(cursor);
+
+	char tag = get_tape_tag(&tape, cursor->index);
+
+	if (tag == 's') {
+		return JSON_NODE_STRING;
+	} else if (tag == '#') {
+		return JSON_NODE_NUMBER;
+	}
+	return json_tape_get_type(&tape, cursor->index);
+}
+
+size_t json_cursor_get_count(struct json_cursor *cursor) {
+	struct json_tape tape = get_cursor_tape(cursor);
+	return json_tape_get_count(&tape, cursor->index);
+}
+
+// Points the child at the first value of the array or object, or returns false if it's empty
+bool json_cursor_first(struct json_cursor *cursor, struct json_cursor *child) {
+	struct json_tape tape = get_cursor_tape(cursor);
+
+	size_t close_index = get_tape_payload(&tape, cursor->index) - 1;
+	if (cursor->index + 1 == close_index) {
+		return false;
+	}
+
+	// An object's values come right after their keys
+	bool in_object = get_tape_tag(&tape, cursor->index) == '{';
+
+	*child = (struct json_cursor){
+		.buffer = cursor->buffer,
+		.index = cursor->index + 1 + in_object,
+		.end = close_index,
+		.in_object = in_object,
+	};
+
+	return true;
+}
+
+// Moves the cursor to the next value of its array or object, or returns false if it was the last one
+// Arrays and objects are skipped in one step, without looking at what's inside of them
+bool json_cursor_next(struct json_cursor *cursor) {
+	struct json_tape tape = get_cursor_tape(cursor);
+
+	size_t next_index = json_tape_next(&tape, cursor->index);
+	if (next_index == cursor->end) {
+		return false;
+	}
+
+	cursor->index = next_index + cursor->in_object;
+
+	return true;
+}
+
+// Points the value at the field with the key, or returns JSON_FIELD_NOT_FOUND
+enum json_status json_cursor_field(struct json_cursor *cursor, const char *key, struct json_cursor *value) {
+	struct json_tape tape = get_cursor_tape(cursor);
+
+	enum json_status status = setjmp(g->error_jmp_buffer);
+	if (status) {
+		return status;
+	}
+
+	size_t key_length = strlen(key);
+
+	struct json_cursor child;
+	if (!json_cursor_first(cursor, &child)) {
+		return JSON_FIELD_NOT_FOUND;
+	}
+
+	do {
+		if (is_deferred_key(&tape, child.index - 1, key, key_length)) {
+			*value = child;
+			return JSON_OK;
+		}
+	} while (json_cursor_next(&child));
+
+	return JSON_FIELD_NOT_FOUND;
+}
+
+// The cursor has to point at a value in an object
+enum json_status json_cursor_get_key(struct json_cursor *cursor, char **key) {
+	struct json_tape tape = get_cursor_tape(cursor);
+
+	enum json_status status = setjmp(g->error_jmp_buffer);
+	if (status) {
+		return status;
+	}
+
+	*key = get_deferred_string(&tape, cursor->index - 1);
+
+	return JSON_OK;
+}
+
+enum json_status json_cursor_get_string(struct json_cursor *cursor, char **string) {
+	struct json_tape tape = get_cursor_tape(cursor);
+
+	enum json_status status = setjmp(g->error_jmp_buffer);
+	if (status) {
+		return status;
+	}
+
+	*string = get_deferred_string(&tape, cursor->index);
+
+	return JSON_OK;
+}
+
+// The number isn't stored, so it's converted again every time
+enum json_status json_cursor_get_number(struct json_cursor *cursor, double *number) {
+	struct json_tape tape = get_cursor_tape(cursor);
+
+	enum json_status status = setjmp(g->error_jmp_buffer);
+	if (status) {
+		return status;
+	}
+
+	size_t number_index = get_tape_payload(&tape, cursor->index);
+	size_t number_end = find_scalar_end(g->text, number_index, g->text_size);
+
+	*number = parse_number(g->text + number_index, number_end - number_index);
+
+	return JSON_OK;
+}
+
+bool json_cursor_get_bool(struct json_cursor *cursor) {
+	struct json_tape tape = get_cursor_tape(cursor);
+	return json_tape_get_bool(&tape, cursor->index);
+}
+
+// Steps over a word, or over both words of a number, without skipping the children of arrays and objects
+static size_t get_next_tape_word(struct json_tape *tape, size_t index) {
+	return get_tape_tag(tape, index) == 'd' ? index + 2 : index + 1;
+}
+
+static bool write_snapshot_words(FILE *f, struct json_tape *tape) {
+	// The strings are written in the order they're on the tape, so their offsets have to be rewritten
+	uint64_t string_offset = 0;
+
+	for (size_t i = 0; i < tape->word_count; i = get_next_tape_word(tape, i)) {
+		uint64_t word = tape->words[i];
+
+		if (get_tape_tag(tape, i) == '"') {
+			word = (uint64_t)'"' << TAPE_TAG_SHIFT | string_offset;
+			string_offset += strlen(json_tape_get_string(tape, i)) + 1;
+		}
+
+		if (fwrite(&word, sizeof(word), 1, f) != 1) {
+			return false;
+		}
+
+		// The number's double
+		if (get_tape_tag(tape, i) == 'd' && fwrite(tape->words + i + 1, sizeof(*tape->words), 1, f) != 1) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool write_snapshot_strings(FILE *f, struct json_tape *tape) {
+	for (size_t i = 0; i < tape->word_count; i = get_next_tape_word(tape, i)) {
+		if (get_tape_tag(tape, i) == '"') {
+			char *string = json_tape_get_string(tape, i);
+			if (fwrite(string, strlen(string) + 1, 1, f) != 1) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Writes the tape to a file that json_snapshot_open() can map straight back into memory
+// Only the strings that the tape uses are written, so a tape of a file doesn't drag the rest of the text along
+enum json_status json_snapshot_write(char *snapshot_path, struct json_tape *tape) {
+	struct snapshot_header header = {
+		.magic = SNAPSHOT_MAGIC,
+		.version = SNAPSHOT_VERSION,
+		.word_count = tape->word_count,
+		.strings_size = 0,
+	};
+
+	for (size_t i = 0; i < tape->word_count; i = get_next_tape_word(tape, i)) {
+		if (get_tape_tag(tape, i) == '"') {
+			header.strings_size += strlen(json_tape_get_string(tape, i)) + 1;
+		}
+	}
+
+	FILE *f = fopen(snapshot_path, "wb");
+	if (!f) {
+		return JSON_FAILED_TO_OPEN_FILE;
+	}
+
+	bool written = fwrite(&header, sizeof(header), 1, f) == 1 && write_snapshot_words(f, tape) && write_snapshot_strings(f, tape);
+
+	if (fclose(f) != 0) {
+		return JSON_FAILED_TO_CLOSE_FILE;
+	}
+
+	return written ? JSON_OK : JSON_FAILED_TO_WRITE_FILE;
+}
+
+static bool is_valid_snapshot(struct snapshot_header *header, size_t size) {
+	if (header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION) {
+		return false;
+	}
+
+	size_t words_size = size - sizeof(*header);
+	if (header->word_count > words_size / sizeof(uint64_t) || header->strings_size != words_size - header->word_count * sizeof(uint64_t)) {
+		return false;
+	}
+
+	// The last string has to be terminated, so reading it can't run off the end of the file
+	char *strings = (char *)header + size - header->strings_size;
+	return header->strings_size == 0 || strings[header->strings_size - 1] == '\0';
+}
+
+// Maps a file that json_snapshot_write() wrote, which can be walked right away with the json_tape_* functions,
+// without parsing or copying anything
+// The mapping is copy-on-write, so the strings can be modified just like the ones that the parser returns,
+// without changing the file
+// The words aren't checked, so only open snapshots that you wrote yourself
+enum json_status json_snapshot_open(char *snapshot_path, struct json_tape *tape) {
+	int fd = open(snapshot_path, O_RDONLY);
+	if (fd == -1) {
+		return JSON_FAILED_TO_OPEN_FILE;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct snapshot_header)) {
+		close(fd);
+		return JSON_INVALID_SNAPSHOT;
+	}
+
+	// The mapping stays around after the file is closed
+	void *mapping = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (close(fd) != 0) {
+		if (mapping != MAP_FAILED) {
+			munmap(mapping, st.st_size);
+		}
+		return JSON_FAILED_TO_CLOSE_FILE;
+	}
+	if (mapping == MAP_FAILED) {
+		return JSON_FAILED_TO_OPEN_FILE;
+	}
+
+	struct snapshot_header *header = mapping;
+
+	if (!is_valid_snapshot(header, st.st_size)) {
+		munmap(mapping, st.st_size);
+		return JSON_INVALID_SNAPSHOT;
+	}
+
+	tape->words = (uint64_t *)(header + 1);
+	tape->word_count = header->word_count;
+	tape->strings = (char *)(tape->words + tape->word_count);
+
+	return JSON_OK;
+}
+
+// Unmaps a tape that json_snapshot_open() returned
+void json_snapshot_close(struct json_tape *tape) {
+	struct snapshot_header *header = (struct snapshot_header *)tape->words - 1;
+	munmap(header, sizeof(*header) + header->word_count * sizeof(uint64_t) + header->strings_size);
+}
+
+// The text that json_write() has written so far
+// Its size keeps counting once the text doesn't fit anymore, so it ends up as the size the text needs
+struct writer {
+	char *text;
+	size_t capacity;
+	size_t size;
+	bool pretty;
+};
+
+static void write_bytes(struct writer *writer, const char *bytes, size_t length) {
+	if (writer->size + length <= writer->capacity) {
+		memcpy(writer->text + writer->size, bytes, length);
+	}
+	writer->size += length;
+}
+
+static void write_indentation(struct writer *writer, size_t depth) {
+	if (!writer->pretty) {
+		return;
+	}
+
+	write_bytes(writer, "\n", 1);
+	for (size_t i = 0; i < depth; i++) {
+		write_bytes(writer, "\t", 1);
+	}
+}
+
+// The runs of characters between the ones that have to be escaped are copied in one go
+static void write_string(struct writer *writer, const char *string) {
+	static const char hex_digits[] = "0123456789abcdef";
+
+	write_bytes(writer, "\"", 1);
+
+	size_t length = strlen(string);
+	size_t i = 0;
+
+	while (true) {
+		size_t escaped_index = find_escaped_character(string, i, length);
+		if (escaped_index > i) {
+			write_bytes(writer, string + i, escaped_index - i);
+		}
+
+		if (escaped_index == length) {
+			break;
+		}
+
+		char c = string[escaped_index];
+
+		if (c == '"') {
+			write_bytes(writer, "\\\"", 2);
+		} else if (c == '\\') {
+			write_bytes(writer, "\\\\", 2);
+		} else if (c == '\b') {
+			write_bytes(writer, "\\b", 2);
+		} else if (c == '\f') {
+			write_bytes(writer, "\\f", 2);
+		} else if (c == '\n') {
+			write_bytes(writer, "\\n", 2);
+		} else if (c == '\r') {
+			write_bytes(writer, "\\r", 2);
+		} else if (c == '\t') {
+			write_bytes(writer, "\\t", 2);
+		} else {
+			char escape[] = {'\\', 'u', '0', '0', hex_digits[c >> 4], hex_digits[c & 0xf]};
+			write_bytes(writer, escape, sizeof(escape));
+		}
+
+		i = escaped_index + 1;
+	}
+
+	write_bytes(writer, "\"", 1);
+}
+
+// Puts the significant digits of the positive number in digits, and returns how many there are
+// The exponent is the power of ten of the first digit
+// snprintf() writes the decimal point of the locale, which is skipped, since JSON always uses a '.'
+static int get_significant_digits(double number, int precision, char *digits, int *exponent) {
+	char text[MAX_WRITTEN_NUMBER_LENGTH];
+	snprintf(text, sizeof(text), "%.*e", precision - 1, number);
+
+	int digit_count = 0;
+	char *c = text;
+	for (; *c != 'e'; c++) {
+		if (is_digit(*c)) {
+			digits[digit_count++] = *c;
+		}
+	}
+
+	// Skips the 'e'
+	c++;
+	bool is_exponent_negative = *c == '-';
+	c++;
+	*exponent = 0;
+	for (; is_digit(*c); c++) {
+		*exponent = *exponent * 10 + *c - '0';
+	}
+	if (is_exponent_negative) {
+		*exponent = -*exponent;
+	}
+
+	return digit_count;
+}
+
+// Whether the digits convert back to the exact same positive number
+// The digits are handed to strtod() without a decimal point, like "15e-1" for 1.5, so the locale doesn't matter
+static bool is_round_trip(double number, const char *digits, int digit_count, int exponent) {
+	char text[MAX_WRITTEN_NUMBER_LENGTH];
+	snprintf(text, sizeof(text), "%.*se%d", digit_count, digits, exponent - digit_count + 1);
+	return strtod(text, NULL) == number;
+}
+
+// Uses at most 17 significant digits, starting from 15 and adding one until the number converts back to the exact same double,
+// laid out like printf()'s "%g" would in the "C" locale
+static void write_number(struct writer *writer, double number) {
+	if (isnan(number)) {
+		write_bytes(writer, "null", 4);
+		return;
+	}
+
+	if (signbit(number)) {
+		write_bytes(writer, "-", 1);
+		number = -number;
+	}
+
+	// The parser turns numbers that are too big back into an infinity
+	if (isinf(number)) {
+		write_bytes(writer, "1e999", 5);
+		return;
+	}
+
+	char digits[MAX_WRITTEN_NUMBER_LENGTH];
+	int digit_count;
+	int exponent;
+	int precision = 15;
+	for (; precision <= 17; precision++) {
+		digit_count = get_significant_digits(number, precision, digits, &exponent);
+		if (is_round_trip(number, digits, digit_count, exponent)) {
+			break;
+		}
+	}
+
+	while (digit_count > 1 && digits[digit_count - 1] == '0') {
+		digit_count--;
+	}
+
+	char text[MAX_WRITTEN_NUMBER_LENGTH];
+	int length = 0;
+
+	if (exponent < -4 || exponent >= precision) {
+		text[length++] = digits[0];
+		if (digit_count > 1) {
+			text[length++] = '.';
+			memcpy(text + length, digits + 1, digit_count - 1);
+			length += digit_count - 1;
+		}
+		length += snprintf(text + length, sizeof(text) - length, "e%c%02d", exponent < 0 ? '-' : '+', abs(exponent));
+	} else if (exponent < 0) {
+		text[length++] = '0';
+		text[length++] = '.';
+		for (int i = -1; i > exponent; i--) {
+			text[length++] = '0';
+		}
+		memcpy(text + length, digits, digit_count);
+		length += digit_count;
+	} else {
+		for (int i = 0; i <= exponent; i++) {
+			text[length++] = i < digit_count ? digits[i] : '0';
+		}
+		if (digit_count > exponent + 1) {
+			text[length++] = '.';
+			memcpy(text + length, digits + exponent + 1, digit_count - exponent - 1);
+			length += digit_count - exponent - 1;
+		}
+	}
+
+	write_bytes(writer, text, length);
+}
+
+static void write_leaf(struct writer *writer, struct json_node *node) {
+	switch (node->type) {
+	case JSON_NODE_STRING:
+		write_string(writer, node->string);
+		break;
+	case JSON_NODE_NUMBER:
+		write_number(writer, node->number);
+		break;
+	case JSON_NODE_BOOL:
+		if (node->boolean) {
+			write_bytes(writer, "true", 4);
+		} else {
+			write_bytes(writer, "false", 5);
+		}
+		break;
+	case JSON_NODE_NULL:
+		write_bytes(writer, "null", 4);
+		break;
+	case JSON_NODE_ARRAY:
+		write_bytes(writer, "[]", 2);
+		break;
+	case JSON_NODE_OBJECT:
+		write_bytes(writer, "{}", 2);
+		break;
+	}
+}
+
+static bool is_container_with_children(struct json_node *node) {
+	return (node->type == JSON_NODE_ARRAY && node->array.value_count > 0) || (node->type == JSON_NODE_OBJECT && node->object.field_count > 0);
+}
+
+static size_t get_child_count(struct json_node *node) {
+	return node->type == JSON_NODE_OBJECT ? node->object.field_count : node->array.value_count;
+}
+
+// Doesn't recurse, so the depth of the trees it can write is only limited by the levels array
+// Every array or object that the writer is inside of has a level, with the index of the value being written
+// Returns false when the tree is nested deeper than the level capacity
+static bool write_node(struct writer *writer, struct json_node *root, struct json_write_level *levels, size_t level_capacity) {
+	struct json_node *value = root;
+	size_t depth = 0;
+
+	while (true) {
+		if (is_container_with_children(value)) {
+			if (depth == level_capacity) {
+				return false;
+			}
+			levels[depth++] = (struct json_write_level){.container = value, .index = 0};
+
+			write_bytes(writer, value->type == JSON_NODE_OBJECT ? "{" : "[", 1);
+		} else {
+			write_leaf(writer, value);
+
+			if (depth == 0) {
+				return true;
+			}
+
+			levels[depth - 1].index++;
+		}
+
+		struct json_write_level *level = levels + depth - 1;
+
+		// Goes up past every array and object whose values have all been written
+		while (level->index == get_child_count(level->container)) {
+			depth--;
+			write_indentation(writer, depth);
+			write_bytes(writer, level->container->type == JSON_NODE_OBJECT ? "}" : "]", 1);
+
+			if (depth == 0) {
+				return true;
+			}
+
+			level--;
+			level->index++;
+		}
+
+		if (level->index > 0) {
+			write_bytes(writer, ",", 1);
+		}
+		write_indentation(writer, depth);
+
+		if (level->container->type == JSON_NODE_OBJECT) {
+			struct json_field *field = level->container->object.fields + level->index;
+			write_string(writer, field->key);
+			write_bytes(writer, writer->pretty ? ": " : ":", writer->pretty ? 2 : 1);
+			value = field->value;
+		} else {
+			value = level->container->array.values + level->index;
+		}
+	}
+}
+
+// Stores the length of the text, which has only been written completely if it's less than the text capacity,
+// since the text is null-terminated
+// So passing a capacity of 0 just stores the length, and the text then needs a capacity of one more than that
+// Pretty text puts every value on its own line, indented with tabs
+// The caller provides the levels array, which needs a level for every array or object that the deepest value is in
+// The tree isn't modified, so several threads can write it at the same time
+enum json_status json_write(struct json_node *node, bool pretty, struct json_write_level *levels, size_t level_capacity, char *text, size_t text_capacity, size_t *length) {
+	struct writer writer = {
+		.text = text,
+		.capacity = text_capacity,
+		.size = 0,
+		.pretty = pretty,
+	};
+
+	if (!write_node(&writer, node, levels, level_capacity)) {
+		return JSON_OUT_OF_MEMORY;
+	}
+
+	if (writer.size < text_capacity) {
+		text[writer.size] = '\0';
+	}
+
+	*length = writer.size;
+
+	return JSON_OK;
 }
 
 char *json_get_error_message(enum json_status status) {
@@ -555,8 +3753,6 @@ char *json_get_error_message(enum json_status status) {
 		[JSON_UNRECOGNIZED_CHARACTER] = "Unrecognized character",
 		[JSON_UNCLOSED_STRING] = "Unclosed string",
 		[JSON_DUPLICATE_KEY] = "Duplicate key",
-		[JSON_TOO_MANY_CHILD_NODES] = "Too many child nodes",
-		[JSON_MAX_RECURSION_DEPTH_EXCEEDED] = "Max recursion depth exceeded",
 		[JSON_TRAILING_COMMA] = "Trailing comma",
 		[JSON_EXPECTED_ARRAY_CLOSE] = "Expected ']'",
 		[JSON_EXPECTED_OBJECT_CLOSE] = "Expected '}'",
@@ -570,10 +3766,79 @@ char *json_get_error_message(enum json_status status) {
 		[JSON_UNEXPECTED_COMMA] = "Unexpected ','",
 		[JSON_UNEXPECTED_COLON] = "Unexpected ':'",
 		[JSON_UNEXPECTED_EXTRA_CHARACTER] = "Unexpected extra character",
+		[JSON_UNEXPECTED_NUMBER] = "Unexpected number",
+		[JSON_UNEXPECTED_LITERAL] = "Unexpected true, false or null",
+		[JSON_INVALID_NUMBER] = "Invalid number",
+		[JSON_INVALID_ESCAPE] = "Invalid escape sequence",
+		[JSON_UNESCAPED_CONTROL_CHARACTER] = "Unescaped control character",
+		[JSON_INVALID_UTF8] = "Invalid UTF-8",
+		[JSON_FIELD_NOT_FOUND] = "Field not found",
+		[JSON_INVALID_PROJECTION] = "Invalid projection",
+		[JSON_INVALID_POINTER] = "Invalid JSON Pointer",
+		[JSON_FAILED_TO_WRITE_FILE] = "Failed to write file",
+		[JSON_INVALID_SNAPSHOT] = "Invalid snapshot",
 	};
 	return messages[status];
 }
 
-int json_get_error_line_number(void) {
-	return error_line_number;
+int json_get_error_line_number(void *buffer) {
+	use_buffer(buffer);
+	return g->error_line_number;
+}
+
+size_t json_get_required_size(void *buffer) {
+	use_buffer(buffer);
+	return g->required_size;
+}
+
+void json_set_validates_utf8(void *buffer, bool validates_utf8) {
+	use_buffer(buffer);
+	g->validates_utf8 = validates_utf8;
+}
+
+// A path starts with "$", followed by any number of ".key" and "[*]" steps,
+// and is at most MAX_PROJECTION_PATH_LENGTH characters long
+static bool is_projection_path(const char *path) {
+	const char *start = path;
+
+	if (*path != '$') {
+		return false;
+	}
+	path++;
+
+	while (*path != '\0') {
+		if (*path == '[') {
+			if (path[1] != '*' || path[2] != ']') {
+				return false;
+			}
+		} else if (*path != '.' || path[1] == '\0' || path[1] == '.' || path[1] == '[') {
+			return false;
+		}
+		path = skip_projection_step(path);
+	}
+
+	return path - start <= MAX_PROJECTION_PATH_LENGTH;
+}
+
+// The paths aren't copied, so they have to stay around for as long as the buffer is parsed into
+// Passing no paths turns the projection off again
+enum json_status json_set_projection(void *buffer, const char **paths, size_t path_count) {
+	use_buffer(buffer);
+
+	if (path_count > MAX_PROJECTION_PATHS) {
+		return JSON_INVALID_PROJECTION;
+	}
+	for (size_t path_index = 0; path_index < path_count; path_index++) {
+		if (!is_projection_path(paths[path_index])) {
+			return JSON_INVALID_PROJECTION;
+		}
+	}
+
+	g->projection_paths = paths;
+	g->projection_path_count = path_count;
+
+	// The steps start over from the new paths
+	g->projection_steps_depth = SIZE_MAX;
+
+	return JSON_OK;
 }
@@ -2,6 +2,7 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 struct json_array {
 	struct json_node *values;
@@ -23,14 +24,69 @@ struct json_node {
 		JSON_NODE_STRING,
 		JSON_NODE_ARRAY,
 		JSON_NODE_OBJECT,
+		JSON_NODE_NUMBER,
+		JSON_NODE_BOOL,
+		JSON_NODE_NULL,
 	} type;
 	union {
 		char *string;
 		struct json_array array;
 		struct json_object object;
+		double number;
+		bool boolean;
 	};
 };
 
+// A flat alternative to the tree of nodes, with one 64-bit word per string, '[', ']', '{', '}', true, false and null,
+// and two per number
+// The value at index 0 is the root, the first child of an array or object is right after it,
+// and an object's children alternate between keys and their values
+// The strings are offsets into the strings pointer, so the words can be moved around
+struct json_tape {
+	uint64_t *words;
+	size_t word_count;
+	char *strings;
+};
+
+// Points at a value of a document that json_index() or json_index_memory() indexed
+// Only the structure of the document is checked up front,
+// its strings and numbers are only lexed once a cursor reaches them
+struct json_cursor {
+	void *buffer;
+	size_t index;
+
+	// Where the array or object that the value is in ends
+	size_t end;
+	bool in_object;
+};
+
+// One reference token of a JSON Pointer, like "limits" or "0" in "/config/limits/0/name"
+struct json_pointer_token {
+	char *key;
+	size_t key_length;
+
+	// The key hashed with the seed of the buffer that the pointer was compiled for
+	uint64_t key_hash;
+
+	// SIZE_MAX when the token can't be an array index
+	size_t index;
+};
+
+// A JSON Pointer that json_compile_pointer() split into its tokens, so it can be looked up over and over
+// The caller provides the tokens array
+struct json_pointer {
+	struct json_pointer_token *tokens;
+	size_t token_capacity;
+	size_t token_count;
+	uint64_t hash_seed[2];
+};
+
+// An array or object that json_write() is inside of, and the index of its value that is being written
+struct json_write_level {
+	struct json_node *container;
+	size_t index;
+};
+
 enum json_status {
 	JSON_OK,
 	JSON_OUT_OF_MEMORY,
@@ -43,8 +99,6 @@ enum json_status {
 	JSON_UNRECOGNIZED_CHARACTER,
 	JSON_UNCLOSED_STRING,
 	JSON_DUPLICATE_KEY,
-	JSON_TOO_MANY_CHILD_NODES,
-	JSON_MAX_RECURSION_DEPTH_EXCEEDED,
 	JSON_TRAILING_COMMA,
 	JSON_EXPECTED_ARRAY_CLOSE,
 	JSON_EXPECTED_OBJECT_CLOSE,
@@ -58,9 +112,80 @@ enum json_status {
 	JSON_UNEXPECTED_COMMA,
 	JSON_UNEXPECTED_COLON,
 	JSON_UNEXPECTED_EXTRA_CHARACTER,
+	JSON_UNEXPECTED_NUMBER,
+	JSON_UNEXPECTED_LITERAL,
+	JSON_INVALID_NUMBER,
+	JSON_INVALID_ESCAPE,
+	JSON_UNESCAPED_CONTROL_CHARACTER,
+	JSON_INVALID_UTF8,
+	JSON_FIELD_NOT_FOUND,
+	JSON_INVALID_PROJECTION,
+	JSON_INVALID_POINTER,
+	JSON_FAILED_TO_WRITE_FILE,
+	JSON_INVALID_SNAPSHOT,
+};
+
+// Every callback is optional
+// The strings stay valid until the buffer is parsed into again
+struct json_callbacks {
+	void *user_data;
+	void (*on_object_start)(void *user_data);
+	void (*on_key)(void *user_data, char *key);
+	void (*on_object_end)(void *user_data);
+	void (*on_array_start)(void *user_data);
+	void (*on_array_end)(void *user_data);
+	void (*on_string)(void *user_data, char *string);
+	void (*on_number)(void *user_data, double number);
+	void (*on_bool)(void *user_data, bool boolean);
+	void (*on_null)(void *user_data);
+};
+
+struct json_batch_document {
+	char *json_file_path;
+	void *buffer;
+	size_t buffer_capacity;
+	struct json_node node;
+	enum json_status status;
 };
 
 bool json_init(void *buffer, size_t buffer_capacity) __attribute__((warn_unused_result));
 enum json_status json(char *json_file_path, struct json_node *returned, void *buffer, size_t buffer_capacity) __attribute__((warn_unused_result));
+enum json_status json_parse_memory(const char *data, size_t data_size, struct json_node *returned, void *buffer, size_t buffer_capacity) __attribute__((warn_unused_result));
+enum json_status json_sax(char *json_file_path, struct json_callbacks *callbacks, void *buffer, size_t buffer_capacity) __attribute__((warn_unused_result));
+enum json_status json_sax_memory(const char *data, size_t data_size, struct json_callbacks *callbacks, void *buffer, size_t buffer_capacity) __attribute__((warn_unused_result));
+enum json_status json_parse_tape(char *json_file_path, struct json_tape *returned, void *buffer, size_t buffer_capacity) __attribute__((warn_unused_result));
+enum json_status json_parse_tape_memory(const char *data, size_t data_size, struct json_tape *returned, void *buffer, size_t buffer_capacity) __attribute__((warn_unused_result));
+enum json_status json_feed_start(struct json_callbacks *callbacks, void *buffer, size_t buffer_capacity) __attribute__((warn_unused_result));
+enum json_status json_feed(const char *chunk, size_t chunk_size, void *buffer) __attribute__((warn_unused_result));
+enum json_status json_finish(void *buffer) __attribute__((warn_unused_result));
+void json_parse_batch(struct json_batch_document *documents, size_t document_count, size_t thread_count);
+struct json_node *json_object_get(struct json_object *object, const char *key);
+enum json_status json_compile_pointer(char *pointer, struct json_pointer *compiled, void *buffer) __attribute__((warn_unused_result));
+struct json_node *json_pointer_get(struct json_node *root, struct json_pointer *pointer);
+void json_pointer_get_batch(struct json_node *root, struct json_pointer *pointers, size_t pointer_count, struct json_node **results);
+enum json_status json_write(struct json_node *node, bool pretty, struct json_write_level *levels, size_t level_capacity, char *text, size_t text_capacity, size_t *length) __attribute__((warn_unused_result));
+enum json_status json_snapshot_write(char *snapshot_path, struct json_tape *tape) __attribute__((warn_unused_result));
+enum json_status json_snapshot_open(char *snapshot_path, struct json_tape *tape) __attribute__((warn_unused_result));
+void json_snapshot_close(struct json_tape *tape);
+int json_tape_get_type(struct json_tape *tape, size_t index);
+char *json_tape_get_string(struct json_tape *tape, size_t index);
+double json_tape_get_number(struct json_tape *tape, size_t index);
+bool json_tape_get_bool(struct json_tape *tape, size_t index);
+size_t json_tape_get_count(struct json_tape *tape, size_t index);
+size_t json_tape_next(struct json_tape *tape, size_t index);
+enum json_status json_index(char *json_file_path, struct json_cursor *root, void *buffer, size_t buffer_capacity) __attribute__((warn_unused_result));
+enum json_status json_index_memory(const char *data, size_t data_size, struct json_cursor *root, void *buffer, size_t buffer_capacity) __attribute__((warn_unused_result));
+int json_cursor_get_type(struct json_cursor *cursor);
+size_t json_cursor_get_count(struct json_cursor *cursor);
+bool json_cursor_first(struct json_cursor *cursor, struct json_cursor *child);
+bool json_cursor_next(struct json_cursor *cursor);
+enum json_status json_cursor_field(struct json_cursor *cursor, const char *key, struct json_cursor *value) __attribute__((warn_unused_result));
+enum json_status json_cursor_get_key(struct json_cursor *cursor, char **key) __attribute__((warn_unused_result));
+enum json_status json_cursor_get_string(struct json_cursor *cursor, char **string) __attribute__((warn_unused_result));
+enum json_status json_cursor_get_number(struct json_cursor *cursor, double *number) __attribute__((warn_unused_result));
+bool json_cursor_get_bool(struct json_cursor *cursor);
 char *json_get_error_message(enum json_status status);
-int json_get_error_line_number(void);
+int json_get_error_line_number(void *buffer);
+size_t json_get_required_size(void *buffer);
+void json_set_validates_utf8(void *buffer, bool validates_utf8);
+enum json_status json_set_projection(void *buffer, const char **paths, size_t path_count) __attribute__((warn_unused_result));
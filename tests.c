@@ -1,9 +1,12 @@
 #include "json.h"
 
 #include <assert.h>
+#include <dirent.h>
+#include <locale.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 static char buffer[420420];
 
@@ -17,7 +20,7 @@ static char buffer[420420];
 		fprintf(\
 			stderr,\
 			"json.c:%d: %s in %s\n",\
-			json_get_error_line_number(),\
+			json_get_error_line_number(buffer),\
 			json_get_error_message(status),\
 			path\
 		);\
@@ -36,7 +39,7 @@ static char buffer[420420];
 		fprintf(\
 			stderr,\
 			"json.c:%d: %s in %s\n",\
-			json_get_error_line_number(),\
+			json_get_error_line_number(buffer),\
 			json_get_error_message(status),\
 			path\
 		);\
@@ -44,6 +47,187 @@ static char buffer[420420];
 	}\
 }
 
+#define OK_PARSE_MEMORY(data, data_size, node) {\
+	assert(!json_init(buffer, sizeof(buffer)));\
+	enum json_status status;\
+    do {\
+		status = json_parse_memory(data, data_size, node, buffer, sizeof(buffer));\
+    } while (status == JSON_OUT_OF_MEMORY);\
+	if (status) {\
+		fprintf(\
+			stderr,\
+			"json.c:%d: %s in memory\n",\
+			json_get_error_line_number(buffer),\
+			json_get_error_message(status)\
+		);\
+		abort();\
+	}\
+}
+
+#define ERROR_PARSE_MEMORY(data, data_size, error) {\
+	assert(!json_init(buffer, sizeof(buffer)));\
+	struct json_node node;\
+    enum json_status status;\
+    do {\
+        status = json_parse_memory(data, data_size, &node, buffer, sizeof(buffer));\
+    } while (status == JSON_OUT_OF_MEMORY);\
+	if (status != error) {\
+		fprintf(\
+			stderr,\
+			"json.c:%d: %s in memory\n",\
+			json_get_error_line_number(buffer),\
+			json_get_error_message(status)\
+		);\
+		abort();\
+	}\
+}
+
+static void append_event(void *user_data, char *event, char *string) {
+	char *events = user_data;
+	if (events[0]) {
+		strcat(events, " ");
+	}
+	strcat(events, event);
+	if (string) {
+		strcat(events, string);
+	}
+}
+
+static void on_object_start(void *user_data) {
+	append_event(user_data, "{", NULL);
+}
+
+static void on_key(void *user_data, char *key) {
+	append_event(user_data, "key:", key);
+}
+
+static void on_object_end(void *user_data) {
+	append_event(user_data, "}", NULL);
+}
+
+static void on_array_start(void *user_data) {
+	append_event(user_data, "[", NULL);
+}
+
+static void on_array_end(void *user_data) {
+	append_event(user_data, "]", NULL);
+}
+
+static void on_string(void *user_data, char *string) {
+	append_event(user_data, "string:", string);
+}
+
+static void on_number(void *user_data, double number) {
+	char string[42];
+	snprintf(string, sizeof(string), "%g", number);
+	append_event(user_data, "number:", string);
+}
+
+static void on_bool(void *user_data, bool boolean) {
+	append_event(user_data, boolean ? "true" : "false", NULL);
+}
+
+static void on_null(void *user_data) {
+	append_event(user_data, "null", NULL);
+}
+
+static struct json_callbacks get_event_callbacks(char *events) {
+	events[0] = '\0';
+
+	return (struct json_callbacks){
+		.user_data = events,
+		.on_object_start = on_object_start,
+		.on_key = on_key,
+		.on_object_end = on_object_end,
+		.on_array_start = on_array_start,
+		.on_array_end = on_array_end,
+		.on_string = on_string,
+		.on_number = on_number,
+		.on_bool = on_bool,
+		.on_null = on_null,
+	};
+}
+
+// Returns the index of the value after the one at index
+static size_t check_tape_matches_node(struct json_tape *tape, size_t index, struct json_node node) {
+	assert(json_tape_get_type(tape, index) == (int)node.type);
+
+	size_t child_index = index + 1;
+
+	switch (node.type) {
+	case JSON_NODE_STRING:
+		assert(strcmp(json_tape_get_string(tape, index), node.string) == 0);
+		return json_tape_next(tape, index);
+	case JSON_NODE_NUMBER:
+		assert(json_tape_get_number(tape, index) == node.number);
+		return json_tape_next(tape, index);
+	case JSON_NODE_BOOL:
+		assert(json_tape_get_bool(tape, index) == node.boolean);
+		return json_tape_next(tape, index);
+	case JSON_NODE_NULL:
+		return json_tape_next(tape, index);
+	case JSON_NODE_ARRAY:
+		assert(json_tape_get_count(tape, index) == node.array.value_count);
+		for (size_t i = 0; i < node.array.value_count; i++) {
+			child_index = check_tape_matches_node(tape, child_index, node.array.values[i]);
+		}
+		break;
+	case JSON_NODE_OBJECT:
+		assert(json_tape_get_count(tape, index) == node.object.field_count);
+		for (size_t i = 0; i < node.object.field_count; i++) {
+			assert(strcmp(json_tape_get_string(tape, child_index), node.object.fields[i].key) == 0);
+			child_index = check_tape_matches_node(tape, child_index + 1, *node.object.fields[i].value);
+		}
+		break;
+	}
+
+	// Skips the closing word
+	assert(child_index + 1 == json_tape_next(tape, index));
+	return child_index + 1;
+}
+
+static void check_cursor_matches_node(struct json_cursor *cursor, struct json_node node) {
+	assert(json_cursor_get_type(cursor) == (int)node.type);
+
+	struct json_cursor child;
+	char *string;
+	double number;
+
+	switch (node.type) {
+	case JSON_NODE_STRING:
+		assert(json_cursor_get_string(cursor, &string) == JSON_OK);
+		assert(strcmp(string, node.string) == 0);
+		break;
+	case JSON_NODE_NUMBER:
+		assert(json_cursor_get_number(cursor, &number) == JSON_OK);
+		assert(number == node.number);
+		break;
+	case JSON_NODE_BOOL:
+		assert(json_cursor_get_bool(cursor) == node.boolean);
+		break;
+	case JSON_NODE_NULL:
+		break;
+	case JSON_NODE_ARRAY:
+		assert(json_cursor_get_count(cursor) == node.array.value_count);
+		assert(json_cursor_first(cursor, &child) == (node.array.value_count > 0));
+		for (size_t i = 0; i < node.array.value_count; i++) {
+			check_cursor_matches_node(&child, node.array.values[i]);
+			assert(json_cursor_next(&child) == (i + 1 < node.array.value_count));
+		}
+		break;
+	case JSON_NODE_OBJECT:
+		assert(json_cursor_get_count(cursor) == node.object.field_count);
+		assert(json_cursor_first(cursor, &child) == (node.object.field_count > 0));
+		for (size_t i = 0; i < node.object.field_count; i++) {
+			assert(json_cursor_get_key(&child, &string) == JSON_OK);
+			assert(strcmp(string, node.object.fields[i].key) == 0);
+			check_cursor_matches_node(&child, *node.object.fields[i].value);
+			assert(json_cursor_next(&child) == (i + 1 < node.object.field_count));
+		}
+		break;
+	}
+}
+
 static void ok_array_in_array(void) {
 	struct json_node node;
 	OK_PARSE("./tests_ok/array_in_array.json", &node);
@@ -65,6 +249,42 @@ static void ok_array_within_max_recursion_depth(void) {
 	assert(node.array.value_count == 0);
 }
 
+static void ok_array_deep(void) {
+	static char text[2000];
+	memset(text, '[', 1000);
+	memset(text + 1000, ']', 1000);
+
+	struct json_node node;
+	OK_PARSE_MEMORY(text, sizeof(text), &node);
+	for (size_t i = 0; i < 999; i++) {
+		assert(node.type == JSON_NODE_ARRAY);
+		assert(node.array.value_count == 1);
+		node = node.array.values[0];
+	}
+	assert(node.type == JSON_NODE_ARRAY);
+	assert(node.array.value_count == 0);
+}
+
+static void ok_array_wide(void) {
+	static char text[1 + 4000 * 4];
+	text[0] = '[';
+	for (size_t i = 0; i < 4000; i++) {
+		memcpy(text + 1 + i * 4, "\"a\",", 4);
+	}
+
+	// Replaces the last ','
+	text[sizeof(text) - 1] = ']';
+
+	struct json_node node;
+	OK_PARSE_MEMORY(text, sizeof(text), &node);
+	assert(node.type == JSON_NODE_ARRAY);
+	assert(node.array.value_count == 4000);
+	for (size_t i = 0; i < 4000; i++) {
+		assert(node.array.values[i].type == JSON_NODE_STRING);
+		assert(strcmp(node.array.values[i].string, "a") == 0);
+	}
+}
+
 static void ok_array(void) {
 	struct json_node node;
 	OK_PARSE("./tests_ok/array.json", &node);
@@ -72,6 +292,44 @@ static void ok_array(void) {
 	assert(node.array.value_count == 0);
 }
 
+static void ok_batch(void) {
+	static char buffers[5][420420];
+
+	struct json_batch_document documents[] = {
+		{.json_file_path = "./tests_ok/grug.json"},
+		{.json_file_path = "./tests_ok/string_foo.json"},
+		{.json_file_path = "./tests_err/duplicate_key.json"},
+		{.json_file_path = "./tests_ok/array_in_array.json"},
+		{.json_file_path = "./tests_ok/object_foo.json"},
+	};
+	size_t document_count = sizeof(documents) / sizeof(*documents);
+
+	for (size_t i = 0; i < document_count; i++) {
+		documents[i].buffer = buffers[i];
+		documents[i].buffer_capacity = sizeof(buffers[i]);
+		assert(!json_init(documents[i].buffer, documents[i].buffer_capacity));
+	}
+
+	json_parse_batch(documents, document_count, 3);
+
+	assert(documents[0].status == JSON_OK);
+	assert(documents[0].node.type == JSON_NODE_ARRAY);
+	assert(documents[0].node.array.value_count == 2);
+
+	assert(documents[1].status == JSON_OK);
+	assert(strcmp(documents[1].node.string, "foo") == 0);
+
+	assert(documents[2].status == JSON_DUPLICATE_KEY);
+
+	assert(documents[3].status == JSON_OK);
+	assert(documents[3].node.type == JSON_NODE_ARRAY);
+	assert(documents[3].node.array.value_count == 1);
+
+	assert(documents[4].status == JSON_OK);
+	assert(documents[4].node.type == JSON_NODE_OBJECT);
+	assert(strcmp(documents[4].node.object.fields[0].key, "foo") == 0);
+}
+
 static void ok_comma_in_string(void) {
 	struct json_node node;
 	OK_PARSE("./tests_ok/comma_in_string.json", &node);
@@ -79,6 +337,114 @@ static void ok_comma_in_string(void) {
 	assert(strcmp(node.string, ",") == 0);
 }
 
+static enum json_status feed_in_chunks(char *text, size_t text_size, size_t chunk_size, struct json_callbacks *callbacks) {
+	assert(!json_init(buffer, sizeof(buffer)));
+
+	enum json_status status = json_feed_start(callbacks, buffer, sizeof(buffer));
+	if (status) {
+		return status;
+	}
+
+	for (size_t i = 0; i < text_size; i += chunk_size) {
+		size_t size = text_size - i < chunk_size ? text_size - i : chunk_size;
+
+		status = json_feed(text + i, size, buffer);
+		if (status) {
+			return status;
+		}
+	}
+
+	return json_finish(buffer);
+}
+
+// Replaces the XXXXXX at the end of the path, so test runs at the same time don't overwrite each other's files
+static void create_temporary_file(char *path) {
+	int fd = mkstemp(path);
+	assert(fd != -1);
+	assert(close(fd) == 0);
+}
+
+// Returns the length of the text, with enough levels for every tree the tests write except the deep one
+static size_t write_tree(struct json_node *node, bool pretty, char *text, size_t text_capacity) {
+	struct json_write_level levels[42];
+	size_t length;
+	assert(json_write(node, pretty, levels, sizeof(levels) / sizeof(*levels), text, text_capacity, &length) == JSON_OK);
+	return length;
+}
+
+// Feeding a file in chunks of any size has to give the same result as json_sax()
+static void check_feed_matches_sax(char *dir_path) {
+	DIR *dir = opendir(dir_path);
+	assert(dir);
+
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		if (entry->d_name[0] == '.') {
+			continue;
+		}
+
+		char path[420];
+		snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+
+		static char text[420420];
+		FILE *f = fopen(path, "r");
+		assert(f);
+		size_t text_size = fread(text, 1, sizeof(text), f);
+		assert(fclose(f) == 0);
+
+		char expected_events[4200];
+		struct json_callbacks callbacks = get_event_callbacks(expected_events);
+		assert(!json_init(buffer, sizeof(buffer)));
+		enum json_status expected_status = json_sax(path, &callbacks, buffer, sizeof(buffer));
+
+		// An empty file can't be told apart from an empty stream
+		if (expected_status == JSON_FILE_EMPTY) {
+			expected_status = JSON_EXPECTED_VALUE;
+		}
+
+		size_t chunk_sizes[] = {1, 2, 3, 7, 64, sizeof(text)};
+		for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(*chunk_sizes); i++) {
+			char events[4200];
+			callbacks = get_event_callbacks(events);
+
+			enum json_status status = feed_in_chunks(text, text_size, chunk_sizes[i], &callbacks);
+			if (status != expected_status || strcmp(events, expected_events) != 0) {
+				fprintf(
+					stderr,
+					"json.c:%d: %s instead of %s when feeding %s in chunks of %zu\n",
+					json_get_error_line_number(buffer),
+					json_get_error_message(status),
+					json_get_error_message(expected_status),
+					path,
+					chunk_sizes[i]
+				);
+				abort();
+			}
+		}
+	}
+
+	assert(closedir(dir) == 0);
+}
+
+static void ok_feed(void) {
+	check_feed_matches_sax("./tests_ok");
+	check_feed_matches_sax("./tests_err");
+}
+
+static void ok_feed_split_strings(void) {
+	char events[420];
+	struct json_callbacks callbacks = get_event_callbacks(events);
+
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_feed_start(&callbacks, buffer, sizeof(buffer)) == JSON_OK);
+	assert(json_feed("{\"fo", 4, buffer) == JSON_OK);
+	assert(json_feed("o\": [\"ba", 8, buffer) == JSON_OK);
+	assert(json_feed("", 0, buffer) == JSON_OK);
+	assert(json_feed("r\", \"\"]}", 8, buffer) == JSON_OK);
+	assert(json_finish(buffer) == JSON_OK);
+	assert(strcmp(events, "{ key:foo [ string:bar string: ] }") == 0);
+}
+
 static void ok_grug(void) {
 	struct json_node node;
 	OK_PARSE("./tests_ok/grug.json", &node);
@@ -193,6 +559,362 @@ static void ok_grug(void) {
 	field++;
 }
 
+static void ok_memory_object(void) {
+	struct json_node node;
+	char *text = "{\"foo\": [\"bar\", \"baz\"]}";
+	OK_PARSE_MEMORY(text, strlen(text), &node);
+	assert(node.type == JSON_NODE_OBJECT);
+	assert(node.object.field_count == 1);
+	assert(strcmp(node.object.fields[0].key, "foo") == 0);
+	struct json_node *value = node.object.fields[0].value;
+	assert(value->type == JSON_NODE_ARRAY);
+	assert(value->array.value_count == 2);
+	assert(strcmp(value->array.values[0].string, "bar") == 0);
+	assert(strcmp(value->array.values[1].string, "baz") == 0);
+}
+
+static void ok_memory_not_null_terminated(void) {
+	struct json_node node;
+	char text[] = {'"', 'f', 'o', 'o', '"'};
+	OK_PARSE_MEMORY(text, sizeof(text), &node);
+	assert(node.type == JSON_NODE_STRING);
+	assert(strcmp(node.string, "foo") == 0);
+}
+
+static void ok_pointer(void) {
+	struct json_node node;
+	OK_PARSE("./tests_ok/grug.json", &node);
+
+	struct json_pointer_token tokens[4];
+	struct json_pointer pointer = {.tokens = tokens, .token_capacity = 4};
+
+	char name[] = "/0/arguments/1/name";
+	assert(json_compile_pointer(name, &pointer, buffer) == JSON_OK);
+	assert(pointer.token_count == 4);
+	assert(strcmp(json_pointer_get(&node, &pointer)->string, "b") == 0);
+
+	// The compiled pointer can be used again
+	assert(strcmp(json_pointer_get(&node, &pointer)->string, "b") == 0);
+
+	char root[] = "";
+	assert(json_compile_pointer(root, &pointer, buffer) == JSON_OK);
+	assert(json_pointer_get(&node, &pointer) == &node);
+
+	char missing[] = "/1/arguments/1";
+	assert(json_compile_pointer(missing, &pointer, buffer) == JSON_OK);
+	assert(!json_pointer_get(&node, &pointer));
+
+	// Array indexes can't have leading zeros, and "-" is past the end
+	char leading_zero[] = "/01";
+	assert(json_compile_pointer(leading_zero, &pointer, buffer) == JSON_OK);
+	assert(!json_pointer_get(&node, &pointer));
+	char past_end[] = "/-";
+	assert(json_compile_pointer(past_end, &pointer, buffer) == JSON_OK);
+	assert(!json_pointer_get(&node, &pointer));
+
+	char into_string[] = "/0/name/0";
+	assert(json_compile_pointer(into_string, &pointer, buffer) == JSON_OK);
+	assert(!json_pointer_get(&node, &pointer));
+}
+
+static void ok_pointer_batch(void) {
+	struct json_node node;
+	OK_PARSE("./tests_ok/grug.json", &node);
+
+	char paths[][32] = {"/0/arguments/0/name", "/0/arguments/0/type", "/0/arguments/1/name", "/0/name", "/0/nope/x", "/0/nope/y", "/1/arguments/0/type", ""};
+	struct json_pointer_token tokens[8][4];
+	struct json_pointer pointers[8];
+	for (size_t i = 0; i < 8; i++) {
+		pointers[i] = (struct json_pointer){.tokens = tokens[i], .token_capacity = 4};
+		assert(json_compile_pointer(paths[i], pointers + i, buffer) == JSON_OK);
+	}
+
+	struct json_node *results[8];
+	json_pointer_get_batch(&node, pointers, 8, results);
+
+	for (size_t i = 0; i < 8; i++) {
+		assert(results[i] == json_pointer_get(&node, pointers + i));
+	}
+	assert(strcmp(results[1]->string, "i64") == 0);
+	assert(!results[4]);
+	assert(!results[5]);
+	assert(strcmp(results[6]->string, "i32") == 0);
+	assert(results[7] == &node);
+}
+
+static void ok_pointer_escapes(void) {
+	char text[] = "{\"a/b\": {\"m~n\": [1, 2]}, \"\": 3}";
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_node node;
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_OK);
+
+	struct json_pointer_token tokens[3];
+	struct json_pointer pointer = {.tokens = tokens, .token_capacity = 3};
+
+	char escaped[] = "/a~1b/m~0n/1";
+	assert(json_compile_pointer(escaped, &pointer, buffer) == JSON_OK);
+	assert(strcmp(tokens[0].key, "a/b") == 0);
+	assert(strcmp(tokens[1].key, "m~n") == 0);
+	assert(json_pointer_get(&node, &pointer)->number == 2);
+
+	char empty_key[] = "/";
+	assert(json_compile_pointer(empty_key, &pointer, buffer) == JSON_OK);
+	assert(json_pointer_get(&node, &pointer)->number == 3);
+}
+
+static void ok_pointer_many_keys(void) {
+	struct json_node node;
+	OK_PARSE("./tests_ok/object_many_keys.json", &node);
+	assert(node.object.field_count > 8);
+
+	struct json_pointer_token token;
+	struct json_pointer pointer = {.tokens = &token, .token_capacity = 1};
+
+	char abd[] = "/abd";
+	assert(json_compile_pointer(abd, &pointer, buffer) == JSON_OK);
+	assert(json_pointer_get(&node, &pointer) == node.object.fields[7].value);
+
+	// A pointer compiled for another buffer has its keys hashed again
+	static char other_buffer[4200];
+	assert(!json_init(other_buffer, sizeof(other_buffer)));
+	char z[] = "/z";
+	assert(json_compile_pointer(z, &pointer, other_buffer) == JSON_OK);
+	assert(json_pointer_get(&node, &pointer) == node.object.fields[11].value);
+}
+
+static size_t get_required_size_memory(char *text, size_t length) {
+	struct json_node node;
+	assert(json_parse_memory(text, length, &node, buffer, 0) == JSON_OUT_OF_MEMORY);
+	assert(json_parse_memory(text, length, &node, buffer, json_get_required_size(buffer)) == JSON_OUT_OF_MEMORY);
+	return json_get_required_size(buffer);
+}
+
+static void ok_projection(void) {
+	char text[] = "{\"mods\": [{\"name\": \"a\", \"version\": 1}, {\"deps\": [\"x\"], \"name\": \"b\\n\"}], \"other\": {\"name\": \"c\"}}";
+	const char *paths[] = {"$.mods[*].name"};
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_set_projection(buffer, paths, 1) == JSON_OK);
+
+	struct json_node node;
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_OK);
+	assert(node.type == JSON_NODE_OBJECT);
+	assert(node.object.field_count == 1);
+	assert(strcmp(node.object.fields[0].key, "mods") == 0);
+
+	struct json_node mods = *node.object.fields[0].value;
+	assert(mods.type == JSON_NODE_ARRAY);
+	assert(mods.array.value_count == 2);
+	assert(mods.array.values[0].object.field_count == 1);
+	assert(strcmp(mods.array.values[0].object.fields[0].key, "name") == 0);
+	assert(strcmp(mods.array.values[0].object.fields[0].value->string, "a") == 0);
+	assert(mods.array.values[1].object.field_count == 1);
+	assert(strcmp(mods.array.values[1].object.fields[0].value->string, "b\n") == 0);
+
+	// The values that are left out don't take up room in the buffer
+	size_t projected_size = get_required_size_memory(text, strlen(text));
+	assert(json_parse_memory(text, strlen(text), &node, buffer, projected_size) == JSON_OK);
+	assert(json_set_projection(buffer, NULL, 0) == JSON_OK);
+	assert(projected_size < get_required_size_memory(text, strlen(text)));
+	assert(json_set_projection(buffer, paths, 1) == JSON_OK);
+
+	// The tape leaves out the same values
+	struct json_tape tape;
+	assert(json_parse_tape_memory(text, strlen(text), &tape, buffer, sizeof(buffer)) == JSON_OK);
+	assert(tape.word_count == 13);
+}
+
+// Parses into a buffer of exactly the required size, so ASan catches anything that's written without being counted
+// The node points into the returned buffer, which has to be freed
+static char *parse_memory_exactly(char *text, const char **paths, size_t path_count, struct json_node *node) {
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_set_projection(buffer, paths, path_count) == JSON_OK);
+	size_t size = get_required_size_memory(text, strlen(text));
+
+	char *exact_buffer = malloc(size);
+	assert(exact_buffer);
+	assert(!json_init(exact_buffer, size));
+	assert(json_set_projection(exact_buffer, paths, path_count) == JSON_OK);
+	assert(json_parse_memory(text, strlen(text), node, exact_buffer, size) == JSON_OK);
+	return exact_buffer;
+}
+
+// The strings in an array are left out when the array's values don't lead to any of the paths
+static void ok_projection_left_out_array_values(void) {
+	char long_string[2001];
+	memset(long_string, 'x', sizeof(long_string) - 1);
+	long_string[sizeof(long_string) - 1] = '\0';
+
+	static char text[4200];
+	snprintf(text, sizeof(text), "{\"a\": [\"%s\", {\"b\": \"c\"}], \"d\": 1}", long_string);
+	const char *paths[] = {"$.a.b", "$.d"};
+
+	struct json_node node;
+	char *exact_buffer = parse_memory_exactly(text, paths, 2, &node);
+	assert(node.object.field_count == 2);
+	assert(strcmp(node.object.fields[0].key, "a") == 0);
+	assert(node.object.fields[0].value->array.value_count == 0);
+	assert(strcmp(node.object.fields[1].key, "d") == 0);
+	assert(node.object.fields[1].value->number == 1);
+	free(exact_buffer);
+}
+
+// Keys that are nested deeper than the counting pass keeps track of are copied even when their values are left out
+static void ok_projection_deep_keys(void) {
+	static char text[42000];
+	size_t length = sprintf(text, "{\"skip\": ");
+	for (size_t i = 0; i < 70; i++) {
+		text[length++] = '[';
+	}
+	text[length++] = '{';
+	text[length++] = '"';
+	memset(text + length, 'k', 5000);
+	length += 5000;
+	length += sprintf(text + length, "\": 1}");
+	for (size_t i = 0; i < 70; i++) {
+		text[length++] = ']';
+	}
+	sprintf(text + length, ", \"keep\": 1}");
+	const char *paths[] = {"$.keep"};
+
+	struct json_node node;
+	char *exact_buffer = parse_memory_exactly(text, paths, 1, &node);
+	assert(node.object.field_count == 1);
+	assert(strcmp(node.object.fields[0].key, "keep") == 0);
+	free(exact_buffer);
+}
+
+static void ok_projection_file(void) {
+	const char *paths[] = {"$[*].arguments[*].name", "$[*].name"};
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_set_projection(buffer, paths, 2) == JSON_OK);
+
+	struct json_node node;
+	assert(json("./tests_ok/grug.json", &node, buffer, sizeof(buffer)) == JSON_OK);
+	assert(node.array.value_count == 2);
+
+	struct json_node foo = node.array.values[0];
+	assert(foo.object.field_count == 2);
+	assert(strcmp(foo.object.fields[0].key, "name") == 0);
+	assert(strcmp(foo.object.fields[0].value->string, "foo") == 0);
+	assert(strcmp(foo.object.fields[1].key, "arguments") == 0);
+
+	struct json_node arguments = *foo.object.fields[1].value;
+	assert(arguments.array.value_count == 2);
+	assert(arguments.array.values[1].object.field_count == 1);
+	assert(strcmp(arguments.array.values[1].object.fields[0].value->string, "b") == 0);
+
+	// The path "$" keeps everything
+	paths[1] = "$";
+	assert(json_set_projection(buffer, paths, 2) == JSON_OK);
+	assert(json("./tests_ok/grug.json", &node, buffer, sizeof(buffer)) == JSON_OK);
+	assert(node.array.values[0].object.field_count == 4);
+
+	// So does turning the projection off
+	assert(json_set_projection(buffer, NULL, 0) == JSON_OK);
+	assert(json("./tests_ok/grug.json", &node, buffer, sizeof(buffer)) == JSON_OK);
+	assert(node.array.values[1].object.field_count == 4);
+}
+
+static void ok_projection_sax(void) {
+	char events[420];
+	struct json_callbacks callbacks = get_event_callbacks(events);
+	char *text = "{\"mods\": [{\"name\": \"a\", \"version\": 1}, {\"name\": \"b\"}], \"other\": {\"name\": [\"c\"]}}";
+
+	const char *paths[] = {"$.other", "$.mods[*].version"};
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_set_projection(buffer, paths, 2) == JSON_OK);
+	assert(json_sax_memory(text, strlen(text), &callbacks, buffer, sizeof(buffer)) == JSON_OK);
+	assert(strcmp(events, "{ key:mods [ { key:version number:1 } { } ] key:other { key:name [ string:c ] } }") == 0);
+
+	// ".*" matches every key
+	callbacks = get_event_callbacks(events);
+	paths[0] = "$.*[*].name";
+	assert(json_set_projection(buffer, paths, 1) == JSON_OK);
+	assert(json_sax_memory(text, strlen(text), &callbacks, buffer, sizeof(buffer)) == JSON_OK);
+	assert(strcmp(events, "{ key:mods [ { key:name string:a } { key:name string:b } ] key:other { } }") == 0);
+}
+
+static void ok_required_size_file(void) {
+	struct json_node node;
+	char *path = "./tests_ok/grug.json";
+
+	assert(!json_init(buffer, sizeof(buffer)));
+
+	// A capacity of 0 doesn't even fit the internal struct
+	assert(json(path, &node, buffer, 0) == JSON_OUT_OF_MEMORY);
+	size_t capacity = json_get_required_size(buffer);
+	// The text has to fit before the other arrays can be counted, so a file takes at most two retries
+	size_t retries = 0;
+	enum json_status status;
+	while ((status = json(path, &node, buffer, capacity)) == JSON_OUT_OF_MEMORY) {
+		assert(json_get_required_size(buffer) > capacity);
+		capacity = json_get_required_size(buffer);
+		retries++;
+	}
+	assert(status == JSON_OK);
+	assert(retries <= 2);
+	assert(capacity == json_get_required_size(buffer));
+
+	assert(json(path, &node, buffer, capacity - 1) == JSON_OUT_OF_MEMORY);
+	assert(json_get_required_size(buffer) == capacity);
+}
+
+// Only the objects with more than 8 fields need room for an index
+static void ok_required_size_object_indexes(void) {
+	struct json_node node;
+	char *small = "[{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,\"g\":7,\"h\":8},{\"i\":9}]";
+	char *large = "[{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,\"g\":7,\"h\":8,\"i\":9},{}]";
+
+	assert(!json_init(buffer, sizeof(buffer)));
+
+	size_t small_size = get_required_size_memory(small, strlen(small));
+	size_t large_size = get_required_size_memory(large, strlen(large));
+	assert(large_size > small_size);
+
+	assert(json_parse_memory(large, strlen(large), &node, buffer, large_size) == JSON_OK);
+	assert(json_object_get(&node.array.values[0].object, "i")->number == 9);
+
+	// The fields of objects that are nested too deep to be counted still get room for an index
+	static char deep[1000];
+	size_t length = 0;
+	for (size_t i = 0; i < 100; i++) {
+		length += sprintf(deep + length, "[");
+	}
+	length += sprintf(deep + length, "{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,\"g\":7,\"h\":8,\"i\":9}");
+	for (size_t i = 0; i < 100; i++) {
+		length += sprintf(deep + length, "]");
+	}
+
+	size_t deep_size = get_required_size_memory(deep, length);
+	assert(json_parse_memory(deep, length, &node, buffer, deep_size) == JSON_OK);
+	for (size_t i = 0; i < 100; i++) {
+		node = node.array.values[0];
+	}
+	assert(json_object_get(&node.object, "i")->number == 9);
+}
+
+static void ok_required_size_memory(void) {
+	struct json_node node;
+	char *text = "[{\"foo\": \"bar\"}, [\"baz\"]]";
+
+	assert(!json_init(buffer, sizeof(buffer)));
+
+	// A capacity of 0 doesn't even fit the internal struct
+	assert(json_parse_memory(text, strlen(text), &node, buffer, 0) == JSON_OUT_OF_MEMORY);
+	size_t capacity = json_get_required_size(buffer);
+
+	// Text in memory doesn't have to fit in the buffer, so a single retry is enough
+	assert(json_parse_memory(text, strlen(text), &node, buffer, capacity) == JSON_OUT_OF_MEMORY);
+	capacity = json_get_required_size(buffer);
+
+	assert(json_parse_memory(text, strlen(text), &node, buffer, capacity - 1) == JSON_OUT_OF_MEMORY);
+	assert(json_get_required_size(buffer) == capacity);
+
+	assert(json_parse_memory(text, strlen(text), &node, buffer, capacity) == JSON_OK);
+	assert(node.type == JSON_NODE_ARRAY);
+	assert(node.array.value_count == 2);
+}
+
 static void ok_misaligned_buffer(void) {
 	struct json_node node;
 
@@ -211,7 +933,7 @@ static void ok_misaligned_buffer(void) {
 		fprintf(
 			stderr,
 			"json.c:%d: %s in %s\n",
-			json_get_error_line_number(),
+			json_get_error_line_number(misaligned.buffer),
 			json_get_error_message(status),
 			path
 		);
@@ -222,6 +944,114 @@ static void ok_misaligned_buffer(void) {
 	assert(node.array.value_count == 0);
 }
 
+static void ok_multiple_buffers(void) {
+	struct json_node node;
+
+	static char other_buffer[420420];
+
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(!json_init(other_buffer, sizeof(other_buffer)));
+
+	assert(json("./tests_err/duplicate_key.json", &node, buffer, sizeof(buffer)) == JSON_DUPLICATE_KEY);
+	int error_line_number = json_get_error_line_number(buffer);
+	assert(error_line_number != 0);
+
+	// Parsing with another buffer doesn't affect the first one
+	assert(json("./tests_ok/string_foo.json", &node, other_buffer, sizeof(other_buffer)) == JSON_OK);
+	assert(json_get_error_line_number(buffer) == error_line_number);
+	assert(json_get_error_line_number(other_buffer) == 0);
+	assert(strcmp(node.string, "foo") == 0);
+}
+
+static void ok_numbers(void) {
+	char *texts[] = {
+		"0", "-0", "1", "-1", "1.5", "3.14159", "1e10", "1E-5", "2.5e+3", "123456789012345678901234567890",
+		"0.1", "9007199254740993", "5e-324", "1.7976931348623157e308",
+	};
+	size_t text_count = sizeof(texts) / sizeof(*texts);
+
+	struct json_node node;
+	OK_PARSE("./tests_ok/numbers.json", &node);
+	assert(node.type == JSON_NODE_ARRAY);
+	assert(node.array.value_count == text_count);
+	for (size_t i = 0; i < text_count; i++) {
+		assert(node.array.values[i].type == JSON_NODE_NUMBER);
+		assert(node.array.values[i].number == strtod(texts[i], NULL));
+	}
+}
+
+static void ok_numbers_random(void) {
+	srand(42);
+	for (size_t i = 0; i < 10000; i++) {
+		char text[64];
+		int length = snprintf(text, sizeof(text), "%s%d.%de%d", rand() % 2 ? "-" : "", rand(), rand() % 100000, rand() % 600 - 300);
+
+		struct json_node node;
+		OK_PARSE_MEMORY(text, length, &node);
+		assert(node.type == JSON_NODE_NUMBER);
+		assert(node.number == strtod(text, NULL));
+	}
+}
+
+// Numbers of any length are rounded correctly, even when only digits far past the first ones decide it
+static void ok_numbers_long(void) {
+	static char text[2000];
+
+	// 2^53 + 1 is exactly halfway between two doubles, so it's rounded to the even one, which is 2^53
+	strcpy(text, "9007199254740993");
+	memset(text + 16, '0', 1500);
+	strcpy(text + 1516, "e-1500");
+
+	struct json_node node;
+	OK_PARSE_MEMORY(text, strlen(text), &node);
+	assert(node.number == 9007199254740992.0);
+
+	// Any digit after the halfway point rounds it up
+	strcpy(text + 1516, "1e-1501");
+	OK_PARSE_MEMORY(text, strlen(text), &node);
+	assert(node.number == 9007199254740994.0);
+
+	// A long fraction of zeros in front of the digits
+	strcpy(text, "-0.");
+	memset(text + 3, '0', 200);
+	strcpy(text + 203, "15");
+	OK_PARSE_MEMORY(text, strlen(text), &node);
+	assert(node.number == -1.5e-201);
+
+	// Numbers used to be rejected from 420 characters on
+	memset(text, '1', 421);
+	text[421] = '\0';
+	OK_PARSE_MEMORY(text, strlen(text), &node);
+	assert(node.number == strtod(text, NULL));
+}
+
+// The numbers are read and written with a '.', no matter the locale
+static void ok_numbers_locale(void) {
+	char *locales[] = {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "nl_NL.UTF-8"};
+
+	size_t i = 0;
+	while (i < sizeof(locales) / sizeof(*locales) && !setlocale(LC_NUMERIC, locales[i])) {
+		i++;
+	}
+
+	// The test can only be run on systems that have one of the locales
+	if (i == sizeof(locales) / sizeof(*locales)) {
+		return;
+	}
+
+	char *text = "[1.5, 0.1234567890123456789012345, 1.5e-400]";
+	struct json_node node;
+	OK_PARSE_MEMORY(text, strlen(text), &node);
+	assert(node.array.values[0].number == 1.5);
+	assert(node.array.values[1].number > 0.12345 && node.array.values[1].number < 0.12346);
+
+	char written[420];
+	write_tree(&node, false, written, sizeof(written));
+	assert(strcmp(written, "[1.5,0.12345678901234568,0]") == 0);
+
+	setlocale(LC_NUMERIC, "C");
+}
+
 static void ok_object_foo(void) {
 	struct json_node node;
 	OK_PARSE("./tests_ok/object_foo.json", &node);
@@ -254,6 +1084,84 @@ static void ok_object_within_max_recursion_depth(void) {
 	assert(node.object.field_count == 0);
 }
 
+static void ok_object_deep(void) {
+	static char text[6003];
+	for (size_t i = 0; i < 1000; i++) {
+		memcpy(text + i * 5, "{\"a\":", 5);
+	}
+	memcpy(text + 5000, "\"b\"", 3);
+	memset(text + 5003, '}', 1000);
+
+	struct json_node node;
+	OK_PARSE_MEMORY(text, sizeof(text), &node);
+	for (size_t i = 0; i < 1000; i++) {
+		assert(node.type == JSON_NODE_OBJECT);
+		assert(node.object.field_count == 1);
+		assert(strcmp(node.object.fields[0].key, "a") == 0);
+		node = *node.object.fields[0].value;
+	}
+	assert(node.type == JSON_NODE_STRING);
+	assert(strcmp(node.string, "b") == 0);
+}
+
+static void ok_object_get(void) {
+	struct json_node node;
+	OK_PARSE("./tests_ok/object_many_keys.json", &node);
+	assert(node.object.field_count > 8);
+	char *keys[] = {"", "a", "b", "ab", "ac", "ba", "abc", "abd", "bcd", "x", "y", "z"};
+	for (size_t i = 0; i < 12; i++) {
+		struct json_node *value = json_object_get(&node.object, keys[i]);
+		assert(value == node.object.fields[i].value);
+	}
+	assert(!json_object_get(&node.object, "abcd"));
+	assert(!json_object_get(&node.object, "c"));
+
+	OK_PARSE("./tests_ok/object_similar_keys.json", &node);
+	assert(node.object.field_count <= 8);
+	assert(json_object_get(&node.object, "ac") == node.object.fields[2].value);
+	assert(!json_object_get(&node.object, "a"));
+}
+
+// Objects that weren't parsed don't have an index in front of their fields, so they're searched directly
+static void ok_object_get_without_index(void) {
+	struct json_node node;
+	OK_PARSE("./tests_ok/object_many_keys.json", &node);
+
+	// Leaving off the last field makes the index not match the object anymore
+	struct json_object shorter = {.fields = node.object.fields, .field_count = 11};
+	assert(json_object_get(&shorter, "z") == NULL);
+	assert(json_object_get(&shorter, "y") == node.object.fields[10].value);
+
+	// The memory in front of the fields is readable, but isn't an index
+	static struct json_field fields[32];
+	static struct json_node values[12];
+	char *keys[] = {"k0", "k1", "k2", "k3", "k4", "k5", "k6", "k7", "k8", "k9", "k10", "k11"};
+	for (size_t i = 0; i < 12; i++) {
+		fields[20 + i] = (struct json_field){.key = keys[i], .value = values + i};
+	}
+	struct json_object built = {.fields = fields + 20, .field_count = 12};
+	for (size_t i = 0; i < 12; i++) {
+		assert(json_object_get(&built, keys[i]) == values + i);
+	}
+	assert(!json_object_get(&built, "k12"));
+}
+
+static void ok_object_many_keys(void) {
+	struct json_node node;
+	OK_PARSE("./tests_ok/object_many_keys.json", &node);
+	assert(node.type == JSON_NODE_OBJECT);
+	assert(node.object.field_count == 12);
+	assert(strcmp(node.object.fields[7].key, "abd") == 0);
+	assert(strcmp(node.object.fields[7].value->string, "7") == 0);
+}
+
+static void ok_object_similar_keys(void) {
+	struct json_node node;
+	OK_PARSE("./tests_ok/object_similar_keys.json", &node);
+	assert(node.type == JSON_NODE_OBJECT);
+	assert(node.object.field_count == 4);
+}
+
 static void ok_object(void) {
 	struct json_node node;
 	OK_PARSE("./tests_ok/object.json", &node);
@@ -261,6 +1169,201 @@ static void ok_object(void) {
 	assert(node.object.field_count == 0);
 }
 
+static void ok_sax(void) {
+	char events[420];
+	struct json_callbacks callbacks = get_event_callbacks(events);
+
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_sax("./tests_ok/object_foo.json", &callbacks, buffer, sizeof(buffer)) == JSON_OK);
+	assert(strcmp(events, "{ key:foo string:bar }") == 0);
+
+	// No nodes are stored, so less of the buffer is needed than for building the tree
+	assert(json_sax("./tests_ok/grug.json", &callbacks, buffer, sizeof(buffer)) == JSON_OK);
+	size_t sax_size = json_get_required_size(buffer);
+	struct json_node node;
+	assert(json("./tests_ok/grug.json", &node, buffer, sizeof(buffer)) == JSON_OK);
+	assert(sax_size < json_get_required_size(buffer));
+}
+
+// The text is fed in chunks, so a longer text doesn't need more of the buffer
+static void ok_sax_constant_memory(void) {
+	char events[420];
+	struct json_callbacks callbacks = {.user_data = events};
+
+	static char text[420420];
+	size_t length = 0;
+	text[length++] = '[';
+	for (size_t i = 0; i < 10000; i++) {
+		length += sprintf(text + length, "%s{\"key\": \"value\", \"number\": 42}", i > 0 ? "," : "");
+	}
+	text[length++] = ']';
+
+	char *short_text = "[{\"key\": \"value\", \"number\": 42}]";
+
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_sax_memory(short_text, strlen(short_text), &callbacks, buffer, sizeof(buffer)) == JSON_OK);
+	size_t short_size = json_get_required_size(buffer);
+	assert(json_sax_memory(text, length, &callbacks, buffer, sizeof(buffer)) == JSON_OK);
+	assert(json_get_required_size(buffer) == short_size);
+
+	// The required size is enough to feed the same text again
+	char path[] = "/tmp/json_sax_XXXXXX";
+	create_temporary_file(path);
+	FILE *f = fopen(path, "w");
+	assert(f);
+	assert(fwrite(text, 1, length, f) == length);
+	assert(fclose(f) == 0);
+
+	assert(json_sax(path, &callbacks, buffer, short_size - 1) == JSON_OUT_OF_MEMORY);
+	assert(json_sax(path, &callbacks, buffer, json_get_required_size(buffer)) == JSON_OK);
+	assert(json_get_required_size(buffer) == short_size);
+	assert(unlink(path) == 0);
+}
+
+static void ok_sax_memory(void) {
+	char events[420];
+	struct json_callbacks callbacks = get_event_callbacks(events);
+	char *text = "[{\"a\": [\"b\", {}], \"c\": \"d\"}, []]";
+
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_sax_memory(text, strlen(text), &callbacks, buffer, sizeof(buffer)) == JSON_OK);
+	assert(strcmp(events, "[ { key:a [ string:b { } ] key:c string:d } [ ] ]") == 0);
+
+	callbacks = get_event_callbacks(events);
+	text = "{\"a\": [1.5, -2e3], \"b\": true, \"c\": false, \"d\": null}";
+	assert(json_sax_memory(text, strlen(text), &callbacks, buffer, sizeof(buffer)) == JSON_OK);
+	assert(strcmp(events, "{ key:a [ number:1.5 number:-2000 ] key:b true key:c false key:d null }") == 0);
+}
+
+static void sum_nested_array(void *user_data, char *string) {
+	static char nested_buffer[4200];
+	assert(!json_init(nested_buffer, sizeof(nested_buffer)));
+	struct json_node node;
+	assert(json_parse_memory(string, strlen(string), &node, nested_buffer, sizeof(nested_buffer)) == JSON_OK);
+	assert(node.type == JSON_NODE_ARRAY);
+
+	double *sum = user_data;
+	for (size_t i = 0; i < node.array.value_count; i++) {
+		*sum += node.array.values[i].number;
+	}
+}
+
+// A callback can parse another text with its own buffer
+static void ok_sax_nested_parse(void) {
+	double sum = 0;
+	struct json_callbacks callbacks = {
+		.user_data = &sum,
+		.on_string = sum_nested_array,
+	};
+	char *text = "{\"a\": \"[1,2,3]\", \"b\": [\"[4,5]\", \"[6]\"]}";
+
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_sax_memory(text, strlen(text), &callbacks, buffer, sizeof(buffer)) == JSON_OK);
+	assert(sum == 21);
+
+	sum = 0;
+	assert(json_feed_start(&callbacks, buffer, sizeof(buffer)) == JSON_OK);
+	assert(json_feed(text, 12, buffer) == JSON_OK);
+	assert(json_feed(text + 12, strlen(text) - 12, buffer) == JSON_OK);
+	assert(json_finish(buffer) == JSON_OK);
+	assert(sum == 21);
+}
+
+static void ok_sax_only_some_callbacks(void) {
+	char events[420];
+	events[0] = '\0';
+	struct json_callbacks callbacks = {
+		.user_data = events,
+		.on_string = on_string,
+	};
+	char *text = "{\"a\": [\"b\", \"c\"]}";
+
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_sax_memory(text, strlen(text), &callbacks, buffer, sizeof(buffer)) == JSON_OK);
+	assert(strcmp(events, "string:b string:c") == 0);
+}
+
+static void check_string_escapes(struct json_node node) {
+	assert(node.type == JSON_NODE_OBJECT);
+	assert(node.object.field_count == 4);
+	assert(strcmp(node.object.fields[0].key, "quote \"") == 0);
+	assert(strcmp(node.object.fields[0].value->string, "a\\b/c") == 0);
+	assert(strcmp(node.object.fields[1].key, "escapes") == 0);
+	assert(strcmp(node.object.fields[1].value->string, "\b\f\n\r\t") == 0);
+	assert(strcmp(node.object.fields[2].value->string, "\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80") == 0);
+	assert(strcmp(node.object.fields[3].key, "\\\\") == 0);
+	assert(strcmp(node.object.fields[3].value->string, "\\\"") == 0);
+}
+
+static void ok_snapshot(void) {
+	static char tape_buffer[420420];
+	assert(!json_init(tape_buffer, sizeof(tape_buffer)));
+	struct json_tape tape;
+	assert(json_parse_tape("./tests_ok/grug.json", &tape, tape_buffer, sizeof(tape_buffer)) == JSON_OK);
+	char path[] = "/tmp/json_snapshot_XXXXXX";
+	create_temporary_file(path);
+	assert(json_snapshot_write(path, &tape) == JSON_OK);
+
+	struct json_tape snapshot;
+	assert(json_snapshot_open(path, &snapshot) == JSON_OK);
+	assert(snapshot.word_count == tape.word_count);
+
+	struct json_node node;
+	OK_PARSE("./tests_ok/grug.json", &node);
+	assert(check_tape_matches_node(&snapshot, 0, node) == snapshot.word_count);
+
+	json_snapshot_close(&snapshot);
+	assert(unlink(path) == 0);
+}
+
+static void ok_snapshot_memory(void) {
+	char text[] = "{\"a\": [1.5, true, null], \"b\\n\": \"\"}";
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_tape tape;
+	assert(json_parse_tape_memory(text, strlen(text), &tape, buffer, sizeof(buffer)) == JSON_OK);
+	char path[] = "/tmp/json_snapshot_XXXXXX";
+	create_temporary_file(path);
+	assert(json_snapshot_write(path, &tape) == JSON_OK);
+
+	// The snapshot doesn't need the buffer anymore
+	assert(!json_init(buffer, sizeof(buffer)));
+
+	struct json_tape snapshot;
+	assert(json_snapshot_open(path, &snapshot) == JSON_OK);
+	assert(snapshot.word_count == 11);
+	assert(strcmp(json_tape_get_string(&snapshot, 1), "a") == 0);
+	assert(json_tape_get_number(&snapshot, 3) == 1.5);
+	assert(json_tape_get_bool(&snapshot, 5) == true);
+	assert(json_tape_get_type(&snapshot, 6) == JSON_NODE_NULL);
+	assert(json_tape_next(&snapshot, 2) == 8);
+	assert(strcmp(json_tape_get_string(&snapshot, 8), "b\n") == 0);
+	assert(strcmp(json_tape_get_string(&snapshot, 9), "") == 0);
+
+	json_snapshot_close(&snapshot);
+	assert(unlink(path) == 0);
+}
+
+static void ok_string_escapes(void) {
+	struct json_node node;
+	OK_PARSE("./tests_ok/string_escapes.json", &node);
+	check_string_escapes(node);
+}
+
+static void ok_string_escapes_memory(void) {
+	static char text[420];
+	FILE *f = fopen("./tests_ok/string_escapes.json", "r");
+	assert(f);
+	size_t text_size = fread(text, 1, sizeof(text), f);
+	assert(fclose(f) == 0);
+
+	struct json_node node;
+	OK_PARSE_MEMORY(text, text_size, &node);
+	check_string_escapes(node);
+
+	// The caller's memory isn't modified
+	assert(memcmp(text, "{\"quote \\\"\"", 11) == 0);
+}
+
 static void ok_string_foo(void) {
 	struct json_node node;
 	OK_PARSE("./tests_ok/string_foo.json", &node);
@@ -275,10 +1378,295 @@ static void ok_string(void) {
 	assert(strcmp(node.string, "") == 0);
 }
 
+static void ok_true_false_null(void) {
+	struct json_node node;
+	OK_PARSE("./tests_ok/true_false_null.json", &node);
+	assert(node.type == JSON_NODE_OBJECT);
+	assert(node.object.field_count == 3);
+	assert(node.object.fields[0].value->type == JSON_NODE_BOOL);
+	assert(node.object.fields[0].value->boolean == true);
+	assert(node.object.fields[1].value->type == JSON_NODE_BOOL);
+	assert(node.object.fields[1].value->boolean == false);
+	assert(node.object.fields[2].value->type == JSON_NODE_NULL);
+}
+
+static void ok_tape(void) {
+	static char tape_buffer[420420];
+	assert(!json_init(tape_buffer, sizeof(tape_buffer)));
+	struct json_tape tape;
+	assert(json_parse_tape("./tests_ok/grug.json", &tape, tape_buffer, sizeof(tape_buffer)) == JSON_OK);
+	size_t tape_size = json_get_required_size(tape_buffer);
+
+	struct json_node node;
+	OK_PARSE("./tests_ok/grug.json", &node);
+	assert(check_tape_matches_node(&tape, 0, node) == tape.word_count);
+
+	// The tape needs less of the buffer than the tree
+	assert(tape_size < json_get_required_size(buffer));
+}
+
+static void ok_tape_memory(void) {
+	char text[] = "{\"a\": [\"b\", {}], \"c\": \"d\"}";
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_tape tape;
+	assert(json_parse_tape_memory(text, strlen(text), &tape, buffer, sizeof(buffer)) == JSON_OK);
+	assert(tape.word_count == 10);
+
+	// The words only hold offsets, so they still work after being copied
+	uint64_t words[10];
+	memcpy(words, tape.words, sizeof(words));
+	tape.words = words;
+
+	assert(json_tape_get_type(&tape, 0) == JSON_NODE_OBJECT);
+	assert(json_tape_get_count(&tape, 0) == 2);
+	assert(json_tape_next(&tape, 0) == 10);
+	assert(strcmp(json_tape_get_string(&tape, 1), "a") == 0);
+	assert(json_tape_get_type(&tape, 2) == JSON_NODE_ARRAY);
+	assert(json_tape_get_count(&tape, 2) == 2);
+	assert(json_tape_next(&tape, 2) == 7);
+	assert(strcmp(json_tape_get_string(&tape, 3), "b") == 0);
+	assert(json_tape_get_type(&tape, 4) == JSON_NODE_OBJECT);
+	assert(json_tape_get_count(&tape, 4) == 0);
+	assert(json_tape_next(&tape, 4) == 6);
+	assert(strcmp(json_tape_get_string(&tape, 7), "c") == 0);
+	assert(json_tape_get_type(&tape, 8) == JSON_NODE_STRING);
+	assert(strcmp(json_tape_get_string(&tape, 8), "d") == 0);
+	assert(json_tape_next(&tape, 8) == 9);
+}
+
+static void ok_tape_numbers(void) {
+	char text[] = "[1.5, true, false, null, -2]";
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_tape tape;
+	assert(json_parse_tape_memory(text, strlen(text), &tape, buffer, sizeof(buffer)) == JSON_OK);
+
+	// A number takes two words, since its double needs all 64 bits
+	assert(tape.word_count == 9);
+	assert(json_tape_get_type(&tape, 1) == JSON_NODE_NUMBER);
+	assert(json_tape_get_number(&tape, 1) == 1.5);
+	assert(json_tape_next(&tape, 1) == 3);
+	assert(json_tape_get_type(&tape, 3) == JSON_NODE_BOOL);
+	assert(json_tape_get_bool(&tape, 3) == true);
+	assert(json_tape_get_type(&tape, 4) == JSON_NODE_BOOL);
+	assert(json_tape_get_bool(&tape, 4) == false);
+	assert(json_tape_get_type(&tape, 5) == JSON_NODE_NULL);
+	assert(json_tape_get_number(&tape, 6) == -2);
+}
+
+static void ok_index(void) {
+	static char index_buffer[420420];
+	assert(!json_init(index_buffer, sizeof(index_buffer)));
+	struct json_cursor root;
+	assert(json_index("./tests_ok/grug.json", &root, index_buffer, sizeof(index_buffer)) == JSON_OK);
+
+	struct json_node node;
+	OK_PARSE("./tests_ok/grug.json", &node);
+	check_cursor_matches_node(&root, node);
+
+	// Every string was lexed the first time, so they're just looked up the second time
+	check_cursor_matches_node(&root, node);
+}
+
+static void ok_index_memory(void) {
+	char text[] = "{\"a\": [1, {\"x\": 1.}], \"b\\n\": {\"c\": \"d\\u00e9\"}, \"e\": 2.5, \"f\": true}";
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_cursor root;
+
+	// The invalid number is in a value that is never looked at, so it isn't noticed
+	assert(json_index_memory(text, strlen(text), &root, buffer, sizeof(buffer)) == JSON_OK);
+
+	struct json_cursor value;
+	assert(json_cursor_field(&root, "e", &value) == JSON_OK);
+	double number;
+	assert(json_cursor_get_number(&value, &number) == JSON_OK);
+	assert(number == 2.5);
+
+	assert(json_cursor_field(&root, "f", &value) == JSON_OK);
+	assert(json_cursor_get_type(&value) == JSON_NODE_BOOL);
+	assert(json_cursor_get_bool(&value) == true);
+
+	// The escaped key has to be decoded before it can be compared
+	assert(json_cursor_field(&root, "b\n", &value) == JSON_OK);
+	struct json_cursor nested;
+	assert(json_cursor_field(&value, "c", &nested) == JSON_OK);
+	char *string;
+	assert(json_cursor_get_string(&nested, &string) == JSON_OK);
+	assert(strcmp(string, "d\xc3\xa9") == 0);
+
+	// Only the fields of the object itself are searched
+	assert(json_cursor_field(&value, "e", &nested) == JSON_FIELD_NOT_FOUND);
+	assert(json_cursor_field(&root, "c", &value) == JSON_FIELD_NOT_FOUND);
+
+	// The array is skipped in one step
+	assert(json_cursor_first(&root, &value));
+	assert(json_cursor_get_type(&value) == JSON_NODE_ARRAY);
+	assert(json_cursor_next(&value));
+	assert(json_cursor_get_key(&value, &string) == JSON_OK);
+	assert(strcmp(string, "b\n") == 0);
+}
+
+static void ok_utf8(void) {
+	assert(!json_init(buffer, sizeof(buffer)));
+	json_set_validates_utf8(buffer, true);
+
+	struct json_node node;
+	assert(json("./tests_ok/utf8.json", &node, buffer, sizeof(buffer)) == JSON_OK);
+	assert(node.type == JSON_NODE_OBJECT);
+	assert(node.object.field_count == 3);
+	assert(strcmp(node.object.fields[0].key, "\xc3\xa9") == 0);
+	assert(strcmp(node.object.fields[0].value->string, "\xe2\x82\xac") == 0);
+	assert(strcmp(node.object.fields[1].value->string, "\xf0\x9f\x98\x80") == 0);
+
+	// The multi-byte character crosses the 32 byte chunks of the vectorized validator
+	char text[] = "\"abcdefghijklmnopqrstuvwxyz01234\xe2\x82\xac" "56789\"";
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_OK);
+	assert(strlen(node.string) == strlen(text) - 2);
+
+	assert(json_feed_start(NULL, buffer, sizeof(buffer)) == JSON_OK);
+	assert(json_feed(text, 35, buffer) == JSON_OK);
+	assert(json_feed(text + 35, strlen(text) - 35, buffer) == JSON_OK);
+	assert(json_finish(buffer) == JSON_OK);
+}
+
+static void ok_utf8_not_validated_by_default(void) {
+	struct json_node node;
+	OK_PARSE("./tests_err/invalid_utf8_overlong.json", &node);
+	assert(node.type == JSON_NODE_ARRAY);
+	assert(strcmp(node.array.values[1].string, "\xc0\xaf") == 0);
+}
+
+static void ok_write(void) {
+	char text[] = "{\"a\": [1, 0.1, -2e300, true, false, null], \"b\": {}, \"c\": [], \"d\": {\"e\": \"f\"}}";
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_node node;
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_OK);
+
+	char *expected = "{\"a\":[1,0.1,-2e+300,true,false,null],\"b\":{},\"c\":[],\"d\":{\"e\":\"f\"}}";
+	assert(write_tree(&node, false, NULL, 0) == strlen(expected));
+
+	char written[420];
+	assert(write_tree(&node, false, written, sizeof(written)) == strlen(expected));
+	assert(strcmp(written, expected) == 0);
+
+	// The text only gets null-terminated when the whole of it fits
+	memset(written, 'x', sizeof(written));
+	assert(write_tree(&node, false, written, strlen(expected)) == strlen(expected));
+	assert(written[strlen(expected) - 1] == '}');
+	assert(written[strlen(expected)] == 'x');
+}
+
+static void ok_write_escapes(void) {
+	char text[] = "[\"a\\\"b\\\\c\\nd\\u0001e\\u00e9f\\/\", \"abcdefghijklmnopqrstuvwxyz\\t\"]";
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_node node;
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_OK);
+
+	char written[420];
+	write_tree(&node, false, written, sizeof(written));
+	assert(strcmp(written, "[\"a\\\"b\\\\c\\nd\\u0001e\xc3\xa9" "f/\",\"abcdefghijklmnopqrstuvwxyz\\t\"]") == 0);
+}
+
+static void ok_write_pretty(void) {
+	char text[] = "{\"a\": [1, {}], \"b\": []}";
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_node node;
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_OK);
+
+	char written[420];
+	write_tree(&node, true, written, sizeof(written));
+	assert(strcmp(written, "{\n\t\"a\": [\n\t\t1,\n\t\t{}\n\t],\n\t\"b\": []\n}") == 0);
+}
+
+static void ok_write_round_trip(void) {
+	char *paths[] = {"./tests_ok/grug.json", "./tests_ok/numbers.json", "./tests_ok/string_escapes.json", "./tests_ok/utf8.json"};
+
+	for (size_t i = 0; i < sizeof(paths) / sizeof(*paths); i++) {
+		struct json_node node;
+		OK_PARSE(paths[i], &node);
+
+		static char written[420420];
+		static char rewritten[420420];
+
+		for (int pretty = 0; pretty < 2; pretty++) {
+			size_t length = write_tree(&node, pretty, written, sizeof(written));
+			assert(length < sizeof(written));
+
+			// Parsing the text again has to give the same tree
+			static char other_buffer[420420];
+			assert(!json_init(other_buffer, sizeof(other_buffer)));
+			struct json_node parsed;
+			assert(json_parse_memory(written, length, &parsed, other_buffer, sizeof(other_buffer)) == JSON_OK);
+			assert(write_tree(&parsed, pretty, rewritten, sizeof(rewritten)) == length);
+			assert(strcmp(written, rewritten) == 0);
+		}
+	}
+}
+
+// The writer doesn't recurse, so it can write anything that the parser can parse
+static void ok_write_deep(void) {
+	// Alternates between arrays and objects, which have values both before and after the nested one
+	size_t depth = 100000;
+	char *text = malloc(depth * 16);
+	assert(text);
+	size_t length = 0;
+	for (size_t i = 0; i < depth; i++) {
+		char *open = i % 2 ? "{\"a\":1,\"b\":" : "[1,";
+		strcpy(text + length, open);
+		length += strlen(open);
+	}
+	text[length++] = '2';
+	for (size_t i = depth; i-- > 0;) {
+		char *close = i % 2 ? ",\"c\":2}" : ",2]";
+		strcpy(text + length, close);
+		length += strlen(close);
+	}
+
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_node node;
+	assert(json_parse_memory(text, length, &node, buffer, sizeof(buffer)) == JSON_OUT_OF_MEMORY);
+	size_t capacity = json_get_required_size(buffer);
+	char *deep_buffer = malloc(capacity);
+	assert(deep_buffer);
+	assert(!json_init(deep_buffer, capacity));
+	assert(json_parse_memory(text, length, &node, deep_buffer, capacity) == JSON_OK);
+
+	// None of the arrays and objects are empty, so each of them needs a level
+	struct json_write_level *levels = malloc(depth * sizeof(*levels));
+	assert(levels);
+	char *written = malloc(length + 1);
+	assert(written);
+	size_t written_length;
+	assert(json_write(&node, false, levels, depth - 1, NULL, 0, &written_length) == JSON_OUT_OF_MEMORY);
+	assert(json_write(&node, false, levels, depth, NULL, 0, &written_length) == JSON_OK);
+	assert(written_length == length);
+	assert(json_write(&node, false, levels, depth, written, length + 1, &written_length) == JSON_OK);
+	assert(written_length == length);
+	assert(memcmp(written, text, length) == 0);
+
+	// The tree isn't modified by writing it
+	assert(json_write(&node, false, levels, depth, written, length + 1, &written_length) == JSON_OK);
+	assert(memcmp(written, text, length) == 0);
+	assert(node.type == JSON_NODE_ARRAY);
+	assert(node.array.value_count == 3);
+	assert(node.array.values[1].type == JSON_NODE_OBJECT);
+	assert(node.array.values[1].object.field_count == 3);
+	assert(strcmp(node.array.values[1].object.fields[1].key, "b") == 0);
+	assert(node.array.values[1].object.fields[1].value->type == JSON_NODE_ARRAY);
+
+	free(written);
+	free(levels);
+	free(deep_buffer);
+	free(text);
+}
+
 static void error_duplicate_key(void) {
 	ERROR_PARSE("./tests_err/duplicate_key.json", JSON_DUPLICATE_KEY);
 }
 
+static void error_duplicate_key_many_keys(void) {
+	ERROR_PARSE("./tests_err/duplicate_key_many_keys.json", JSON_DUPLICATE_KEY);
+}
+
 static void error_expected_array_close(void) {
 	ERROR_PARSE("./tests_err/expected_array_close.json", JSON_EXPECTED_ARRAY_CLOSE);
 }
@@ -303,12 +1691,191 @@ static void error_file_empty(void) {
 	ERROR_PARSE("./tests_err/file_empty.json", JSON_FILE_EMPTY);
 }
 
-static void error_max_recursion_depth_array(void) {
-	ERROR_PARSE("./tests_err/max_recursion_depth_array.json", JSON_MAX_RECURSION_DEPTH_EXCEEDED);
+static void error_pointer_invalid(void) {
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_pointer_token tokens[2];
+	struct json_pointer pointer = {.tokens = tokens, .token_capacity = 2};
+
+	char no_slash[] = "a/b";
+	assert(json_compile_pointer(no_slash, &pointer, buffer) == JSON_INVALID_POINTER);
+	char bad_escape[] = "/a~2";
+	assert(json_compile_pointer(bad_escape, &pointer, buffer) == JSON_INVALID_POINTER);
+	char trailing_tilde[] = "/a~";
+	assert(json_compile_pointer(trailing_tilde, &pointer, buffer) == JSON_INVALID_POINTER);
+	char too_many_tokens[] = "/a/b/c";
+	assert(json_compile_pointer(too_many_tokens, &pointer, buffer) == JSON_OUT_OF_MEMORY);
 }
 
-static void error_max_recursion_depth_object(void) {
-	ERROR_PARSE("./tests_err/max_recursion_depth_object.json", JSON_MAX_RECURSION_DEPTH_EXCEEDED);
+static void error_projection_invalid_path(void) {
+	const char *paths[] = {"$.a", "mods"};
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_set_projection(buffer, paths, 2) == JSON_INVALID_PROJECTION);
+	paths[1] = "$.";
+	assert(json_set_projection(buffer, paths, 2) == JSON_INVALID_PROJECTION);
+	paths[1] = "$[0]";
+	assert(json_set_projection(buffer, paths, 2) == JSON_INVALID_PROJECTION);
+	paths[1] = "$..a";
+	assert(json_set_projection(buffer, paths, 2) == JSON_INVALID_PROJECTION);
+
+	// The step that a path is at is stored in 16 bits
+	static char long_path[70000];
+	long_path[0] = '$';
+	long_path[1] = '.';
+	memset(long_path + 2, 'a', 65533);
+	paths[1] = long_path;
+	assert(json_set_projection(buffer, paths, 2) == JSON_OK);
+	long_path[65535] = 'a';
+	assert(json_set_projection(buffer, paths, 2) == JSON_INVALID_PROJECTION);
+	assert(json_set_projection(buffer, NULL, 0) == JSON_OK);
+}
+
+// The values that the projection leaves out are rejected for the same reasons as without it
+static void error_projection_left_out_values(void) {
+	const char *paths[] = {"$.b"};
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_set_projection(buffer, paths, 1) == JSON_OK);
+	struct json_node node;
+
+	char *text = "{\"a\": [1, 2,], \"b\": 1}";
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_TRAILING_COMMA);
+	text = "{\"a\": [1.], \"b\": 1}";
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_INVALID_NUMBER);
+	text = "{\"a\": \"\\q\", \"b\": 1}";
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_INVALID_ESCAPE);
+	text = "{\"a\": \"\\ud800\", \"b\": 1}";
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_INVALID_ESCAPE);
+	text = "{\"a\": [\"\\u00\"], \"b\": 1}";
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_INVALID_ESCAPE);
+
+	// The keys of the fields that are left out are still compared
+	text = "{\"a\": 1, \"a\": 2, \"b\": 1}";
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_DUPLICATE_KEY);
+	text = "{\"a\": {\"c\": 1, \"c\": 2}, \"b\": 1}";
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_DUPLICATE_KEY);
+	text = "{\"a\": 1, \"b\": 1, \"\\u0061\": 2}";
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_DUPLICATE_KEY);
+
+	json_set_validates_utf8(buffer, true);
+	text = "{\"a\": \"\xff\", \"b\": 1}";
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_INVALID_UTF8);
+	text = "{\"a\": [\"\xc0\xaf\"], \"b\": 1}";
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_INVALID_UTF8);
+
+	// A control character would make the key look different to the counting pass than to the parser
+	paths[0] = "$.a";
+	assert(json_set_projection(buffer, paths, 1) == JSON_OK);
+	static char control_key[4200];
+	size_t length = sprintf(control_key, "{\"a%cx\": [\"", '\0');
+	memset(control_key + length, 'y', 3000);
+	length += 3000;
+	length += sprintf(control_key + length, "\"]}");
+	assert(json_parse_memory(control_key, length, &node, buffer, sizeof(buffer)) == JSON_UNESCAPED_CONTROL_CHARACTER);
+	paths[0] = "$.b";
+	assert(json_set_projection(buffer, paths, 1) == JSON_OK);
+
+	// Valid values are still left out
+	text = "{\"a\": [\"\\ud83d\\ude00\", \"\xc3\xa9\"], \"b\": 1}";
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_OK);
+	assert(node.object.field_count == 1);
+	assert(node.object.fields[0].value->number == 1);
+}
+
+static void error_snapshot(void) {
+	struct json_tape snapshot;
+	assert(json_snapshot_open("", &snapshot) == JSON_FAILED_TO_OPEN_FILE);
+	assert(json_snapshot_open("./tests_ok/grug.json", &snapshot) == JSON_INVALID_SNAPSHOT);
+	assert(json_snapshot_open("./tests_err/file_empty.json", &snapshot) == JSON_INVALID_SNAPSHOT);
+
+	struct json_tape tape = {0};
+	assert(json_snapshot_write("", &tape) == JSON_FAILED_TO_OPEN_FILE);
+}
+
+static void error_sax_duplicate_key(void) {
+	char events[420];
+	struct json_callbacks callbacks = get_event_callbacks(events);
+
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_sax("./tests_err/duplicate_key.json", &callbacks, buffer, sizeof(buffer)) == JSON_DUPLICATE_KEY);
+}
+
+static void error_feed_control_character(void) {
+	// The NUL would otherwise cut both keys short to "a"
+	char text[] = {'{', '"', 'a', '\0', 'a', '"', ':', '1', '}'};
+
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_feed_start(NULL, buffer, sizeof(buffer)) == JSON_OK);
+	assert(json_feed(text, sizeof(text), buffer) == JSON_UNESCAPED_CONTROL_CHARACTER);
+
+	ERROR_PARSE_MEMORY(text, sizeof(text), JSON_UNESCAPED_CONTROL_CHARACTER);
+}
+
+static void error_tape_duplicate_key(void) {
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_tape tape;
+	assert(json_parse_tape("./tests_err/duplicate_key_many_keys.json", &tape, buffer, sizeof(buffer)) == JSON_DUPLICATE_KEY);
+	assert(json_parse_tape("./tests_err/duplicate_key.json", &tape, buffer, sizeof(buffer)) == JSON_DUPLICATE_KEY);
+}
+
+static void error_index_invalid_number(void) {
+	char text[] = "[1, 1.]";
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_cursor root;
+	assert(json_index_memory(text, strlen(text), &root, buffer, sizeof(buffer)) == JSON_OK);
+
+	struct json_cursor value;
+	assert(json_cursor_first(&root, &value));
+	double number;
+	assert(json_cursor_get_number(&value, &number) == JSON_OK);
+	assert(number == 1);
+
+	// The number is only checked once it is reached
+	assert(json_cursor_next(&value));
+	assert(json_cursor_get_number(&value, &number) == JSON_INVALID_NUMBER);
+}
+
+static void error_index_invalid_utf8(void) {
+	char text[] = "{\"\xc0\xaf\": 1}";
+	assert(!json_init(buffer, sizeof(buffer)));
+	json_set_validates_utf8(buffer, true);
+	struct json_cursor root;
+	assert(json_index_memory(text, strlen(text), &root, buffer, sizeof(buffer)) == JSON_OK);
+
+	struct json_cursor value;
+	assert(json_cursor_field(&root, "\xc0\xaf", &value) == JSON_INVALID_UTF8);
+}
+
+static void error_index_unclosed_array(void) {
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_cursor root;
+	assert(json_index("./tests_err/expected_array_close.json", &root, buffer, sizeof(buffer)) == JSON_EXPECTED_ARRAY_CLOSE);
+}
+
+static void error_feed_after_error(void) {
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_feed_start(NULL, buffer, sizeof(buffer)) == JSON_OK);
+	assert(json_feed("[,", 2, buffer) == JSON_UNEXPECTED_COMMA);
+	assert(json_feed("]", 1, buffer) == JSON_UNEXPECTED_COMMA);
+	assert(json_finish(buffer) == JSON_UNEXPECTED_COMMA);
+}
+
+static void error_feed_after_finish(void) {
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json_feed_start(NULL, buffer, sizeof(buffer)) == JSON_OK);
+	assert(json_feed("[]", 2, buffer) == JSON_OK);
+	assert(json_finish(buffer) == JSON_OK);
+	assert(json_feed("[]", 2, buffer) == JSON_UNEXPECTED_EXTRA_CHARACTER);
+}
+
+static void error_feed_out_of_memory(void) {
+	static char small_buffer[1000];
+	assert(!json_init(small_buffer, sizeof(small_buffer)));
+	assert(json_feed_start(NULL, small_buffer, sizeof(small_buffer)) == JSON_OK);
+
+	char text[1000];
+	memset(text, 'a', sizeof(text));
+	assert(json_feed("\"", 1, small_buffer) == JSON_OK);
+	assert(json_feed(text, sizeof(text), small_buffer) == JSON_OUT_OF_MEMORY);
+	assert(json_get_required_size(small_buffer) > sizeof(small_buffer));
 }
 
 static void error_trailing_array_comma(void) {
@@ -319,6 +1886,30 @@ static void error_trailing_object_comma(void) {
 	ERROR_PARSE("./tests_err/trailing_object_comma.json", JSON_TRAILING_COMMA);
 }
 
+static void error_invalid_escape(void) {
+	ERROR_PARSE("./tests_err/invalid_escape.json", JSON_INVALID_ESCAPE);
+}
+
+static void error_invalid_escape_hex(void) {
+	ERROR_PARSE("./tests_err/invalid_escape_hex.json", JSON_INVALID_ESCAPE);
+}
+
+static void error_invalid_escape_lone_surrogate(void) {
+	ERROR_PARSE("./tests_err/invalid_escape_lone_surrogate.json", JSON_INVALID_ESCAPE);
+}
+
+static void error_invalid_escape_null(void) {
+	ERROR_PARSE("./tests_err/invalid_escape_null.json", JSON_INVALID_ESCAPE);
+}
+
+static void error_unclosed_string_escaped_quote(void) {
+	ERROR_PARSE("./tests_err/unclosed_string_escaped_quote.json", JSON_UNCLOSED_STRING);
+}
+
+static void error_string_control_character(void) {
+	ERROR_PARSE("./tests_err/string_control_character.json", JSON_UNESCAPED_CONTROL_CHARACTER);
+}
+
 static void error_unclosed_string(void) {
 	ERROR_PARSE("./tests_err/unclosed_string.json", JSON_UNCLOSED_STRING);
 }
@@ -419,39 +2010,240 @@ static void error_unexpected_string_3(void) {
 	ERROR_PARSE("./tests_err/unexpected_string_3.json", JSON_UNEXPECTED_STRING);
 }
 
+// The file is only rejected once json_set_validates_utf8() is called
+static void check_invalid_utf8(char *path) {
+	struct json_node node;
+	assert(!json_init(buffer, sizeof(buffer)));
+	assert(json(path, &node, buffer, sizeof(buffer)) == JSON_OK);
+
+	json_set_validates_utf8(buffer, true);
+	assert(json(path, &node, buffer, sizeof(buffer)) == JSON_INVALID_UTF8);
+
+	char events[420];
+	struct json_callbacks callbacks = get_event_callbacks(events);
+	assert(json_sax(path, &callbacks, buffer, sizeof(buffer)) == JSON_INVALID_UTF8);
+}
+
+static void error_invalid_utf8_continuation(void) {
+	check_invalid_utf8("./tests_err/invalid_utf8_continuation.json");
+}
+
+static void error_invalid_utf8_overlong(void) {
+	check_invalid_utf8("./tests_err/invalid_utf8_overlong.json");
+}
+
+static void error_invalid_utf8_surrogate(void) {
+	check_invalid_utf8("./tests_err/invalid_utf8_surrogate.json");
+}
+
+static void error_invalid_utf8_too_large(void) {
+	check_invalid_utf8("./tests_err/invalid_utf8_too_large.json");
+}
+
+static void error_invalid_utf8_truncated(void) {
+	check_invalid_utf8("./tests_err/invalid_utf8_truncated.json");
+}
+
+static void error_invalid_utf8_feed(void) {
+	char text[] = "[\"a\", \"\xe2\x82\"]";
+
+	assert(!json_init(buffer, sizeof(buffer)));
+	json_set_validates_utf8(buffer, true);
+	assert(json_feed_start(NULL, buffer, sizeof(buffer)) == JSON_OK);
+
+	// The truncated sequence is split over two chunks
+	assert(json_feed(text, 8, buffer) == JSON_OK);
+	assert(json_feed(text + 8, strlen(text) - 8, buffer) == JSON_INVALID_UTF8);
+}
+
+static void error_invalid_number_leading_zero(void) {
+	ERROR_PARSE("./tests_err/invalid_number_leading_zero.json", JSON_INVALID_NUMBER);
+}
+
+static void error_invalid_number_minus(void) {
+	ERROR_PARSE("./tests_err/invalid_number_minus.json", JSON_INVALID_NUMBER);
+}
+
+static void error_invalid_number_no_exponent(void) {
+	ERROR_PARSE("./tests_err/invalid_number_no_exponent.json", JSON_INVALID_NUMBER);
+}
+
+static void error_invalid_number_no_fraction(void) {
+	ERROR_PARSE("./tests_err/invalid_number_no_fraction.json", JSON_INVALID_NUMBER);
+}
+
+static void error_invalid_number_no_fraction_exponent(void) {
+	ERROR_PARSE("./tests_err/invalid_number_no_fraction_exponent.json", JSON_INVALID_NUMBER);
+}
+
+static void error_unexpected_literal(void) {
+	ERROR_PARSE("./tests_err/unexpected_literal.json", JSON_UNEXPECTED_LITERAL);
+}
+
+static void error_unexpected_number(void) {
+	ERROR_PARSE("./tests_err/unexpected_number.json", JSON_UNEXPECTED_NUMBER);
+}
+
+static void error_unrecognized_literal(void) {
+	ERROR_PARSE("./tests_err/unrecognized_literal.json", JSON_UNRECOGNIZED_CHARACTER);
+}
+
+static void error_memory_empty(void) {
+	ERROR_PARSE_MEMORY("", 0, JSON_EXPECTED_VALUE);
+}
+
+static void error_memory_control_character(void) {
+	char text[] = {'"', 'f', '\t', 'o', '"'};
+	ERROR_PARSE_MEMORY(text, sizeof(text), JSON_UNESCAPED_CONTROL_CHARACTER);
+
+	// Past the vector width, so the SIMD scanners find it too.
+	char long_text[100];
+	memset(long_text, 'x', sizeof(long_text));
+	long_text[0] = '"';
+	long_text[80] = '\n';
+	long_text[sizeof(long_text) - 1] = '"';
+	ERROR_PARSE_MEMORY(long_text, sizeof(long_text), JSON_UNESCAPED_CONTROL_CHARACTER);
+}
+
+static void error_memory_unclosed_string(void) {
+	char text[] = {'"', 'f', 'o', 'o'};
+	ERROR_PARSE_MEMORY(text, sizeof(text), JSON_UNCLOSED_STRING);
+}
+
 static void error_unrecognized_character(void) {
 	ERROR_PARSE("./tests_err/unrecognized_character.json", JSON_UNRECOGNIZED_CHARACTER);
 }
 
+static void error_write_too_deep(void) {
+	char text[] = "[1, {\"a\": []}, \"b\"]";
+	assert(!json_init(buffer, sizeof(buffer)));
+	struct json_node node;
+	assert(json_parse_memory(text, strlen(text), &node, buffer, sizeof(buffer)) == JSON_OK);
+
+	// The empty array doesn't need a level of its own
+	struct json_write_level levels[2];
+	size_t length;
+	assert(json_write(&node, false, levels, 1, NULL, 0, &length) == JSON_OUT_OF_MEMORY);
+	assert(json_write(&node, false, levels, 2, NULL, 0, &length) == JSON_OK);
+	assert(length == strlen("[1,{\"a\":[]},\"b\"]"));
+
+	// Neither does a root that isn't an array or object
+	assert(json_write(node.array.values, false, NULL, 0, NULL, 0, &length) == JSON_OK);
+	assert(length == 1);
+}
+
 static void ok_tests(void) {
+	ok_array_deep();
 	ok_array_in_array();
 	ok_array_within_max_recursion_depth();
+	ok_array_wide();
 	ok_array();
+	ok_batch();
 	ok_comma_in_string();
+	ok_feed();
+	ok_feed_split_strings();
 	ok_grug();
+	ok_index();
+	ok_index_memory();
+	ok_memory_not_null_terminated();
+	ok_memory_object();
 	ok_misaligned_buffer();
+	ok_multiple_buffers();
+	ok_object_deep();
+	ok_numbers();
+	ok_numbers_long();
+	ok_numbers_locale();
+	ok_numbers_random();
 	ok_object_foo();
+	ok_object_get();
+	ok_object_get_without_index();
+	ok_object_many_keys();
+	ok_object_similar_keys();
 	ok_object_wide_doesnt_trigger_max_recursion_depth();
 	ok_object_within_max_recursion_depth();
 	ok_object();
+	ok_pointer();
+	ok_pointer_batch();
+	ok_pointer_escapes();
+	ok_pointer_many_keys();
+	ok_projection();
+	ok_projection_file();
+	ok_projection_left_out_array_values();
+	ok_projection_deep_keys();
+	ok_projection_sax();
+	ok_required_size_file();
+	ok_required_size_memory();
+	ok_required_size_object_indexes();
+	ok_sax();
+	ok_sax_constant_memory();
+	ok_sax_memory();
+	ok_sax_nested_parse();
+	ok_sax_only_some_callbacks();
+	ok_snapshot();
+	ok_snapshot_memory();
+	ok_string_escapes();
+	ok_string_escapes_memory();
 	ok_string_foo();
 	ok_string();
+	ok_tape();
+	ok_tape_memory();
+	ok_tape_numbers();
+	ok_true_false_null();
+	ok_utf8();
+	ok_utf8_not_validated_by_default();
+	ok_write();
+	ok_write_deep();
+	ok_write_escapes();
+	ok_write_pretty();
+	ok_write_round_trip();
 }
 
 static void error_tests(void) {
 	error_failed_to_open_file();
 
 	error_duplicate_key();
+	error_duplicate_key_many_keys();
 	error_expected_array_close();
 	error_expected_colon();
 	error_expected_object_close();
 	error_expected_value();
+	error_feed_after_error();
+	error_feed_after_finish();
+	error_feed_control_character();
+	error_feed_out_of_memory();
 	error_file_empty();
-	error_max_recursion_depth_array();
-	error_max_recursion_depth_object();
+	error_index_invalid_number();
+	error_index_invalid_utf8();
+	error_index_unclosed_array();
+	error_invalid_escape();
+	error_invalid_escape_hex();
+	error_invalid_escape_lone_surrogate();
+	error_invalid_escape_null();
+	error_invalid_number_leading_zero();
+	error_invalid_number_minus();
+	error_invalid_number_no_exponent();
+	error_invalid_number_no_fraction();
+	error_invalid_number_no_fraction_exponent();
+	error_invalid_utf8_continuation();
+	error_invalid_utf8_feed();
+	error_invalid_utf8_overlong();
+	error_invalid_utf8_surrogate();
+	error_invalid_utf8_too_large();
+	error_invalid_utf8_truncated();
+	error_memory_control_character();
+	error_memory_empty();
+	error_memory_unclosed_string();
+	error_pointer_invalid();
+	error_projection_invalid_path();
+	error_projection_left_out_values();
+	error_sax_duplicate_key();
+	error_snapshot();
+	error_string_control_character();
+	error_tape_duplicate_key();
 	error_trailing_array_comma();
 	error_trailing_object_comma();
 	error_unclosed_string();
+	error_unclosed_string_escaped_quote();
 	error_unexpected_array_close();
 	error_unexpected_array_object_close();
 	error_unexpected_array_open_1();
@@ -468,6 +2260,8 @@ static void error_tests(void) {
 	error_unexpected_extra_character_array();
 	error_unexpected_extra_character_object();
 	error_unexpected_extra_character_string();
+	error_unexpected_literal();
+	error_unexpected_number();
 	error_unexpected_object_array_close();
 	error_unexpected_object_close();
 	error_unexpected_object_open_1();
@@ -477,6 +2271,8 @@ static void error_tests(void) {
 	error_unexpected_string_2();
 	error_unexpected_string_3();
 	error_unrecognized_character();
+	error_unrecognized_literal();
+	error_write_too_deep();
 }
 
 int main(void) {